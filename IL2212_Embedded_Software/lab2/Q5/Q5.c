@@ -29,9 +29,11 @@ p_5 = actor11SDF 1 1 f_5
 
 #include <stdio.h>
 #include "circular_buffer.h" /* defines data type token as uint8_t */
-
-/* Definition of the channel */
-typedef cbuf_handle_t channel;
+#include "sdf_actor.h" /* defines the channel and the generic SDF actor */
+#include "sdf_schedule.h" /* derives schedule and buffer sizes from the graph */
+#ifdef SDF_STATS
+#include "sdf_stats.h" /* channel and actor counters, build with -DSDF_STATS */
+#endif
 
 /* Definition of the functions 'readToken' and 'writeToken' */
 int readToken(channel ch, token* data) {
@@ -42,190 +44,138 @@ void writeToken(channel ch, token data) {
   circular_buf_put(ch, data);
 }
 
-/* Definition of function 'createFIFO' */
-channel createFIFO(token* buffer, size_t size){
-  return circular_buf_init(buffer, size);
-}
-
-/* Definition of SDF actors */
-
-void actor11SDF(int consum, int prod,
-					 channel* ch_in, channel* ch_out,
-					 void (*f) (token*, token*))
-{
-  token input[consum], output[prod];
-  int i;
-
-  for(i = 0; i < consum; i++) {
-	 readToken(*ch_in, &input[i]);
-  }
-  f(input, output);
-  for(i = 0; i< prod; i++) {	 
-	 writeToken(*ch_out, output[i]);
-  }
-}
-
-void actor12SDF(int consum, int prod1, int prod2,
-					 channel* ch_in, channel* ch_out1, channel* ch_out2,
-					 void (*f) (token*, token*, token*))
-{
-  token input[consum], output1[prod1], output2[prod2];
-  int i;
-
-  for(i = 0; i < consum; i++) {
-	 readToken(*ch_in, &input[i]);
-  }
-  f(input, output1, output2);
-  for(i = 0; i< prod1; i++) {	 
-	 writeToken(*ch_out1, output1[i]);
-  }
-  for(i = 0; i< prod2; i++) {	 
-	 writeToken(*ch_out2, output2[i]);
-  }
-}
-
-void actor21SDF(int consum1, int consum2, int prod,
-					 channel* ch_in1, channel* ch_in2, channel* ch_out,
-					 void (*f) (token*, token*, token*))
-{
-  token input1[consum1], input2[consum2], output[prod];
-  int i;
-
-  for(i = 0; i < consum1; i++) {
-	 readToken(*ch_in1, &input1[i]);
-  }
-  for(i = 0; i < consum2; i++) {
-	 readToken(*ch_in2, &input2[i]);
-  }
-  f(input1, input2, output);
-  for(i = 0; i< prod; i++) {	 
-	 writeToken(*ch_out, output[i]);
+/* Read the tokens of one iteration for a graph input, -1 at end of input */
+int readInputs(sdf_graph* g, int edge) {
+  token input;
+  size_t j;
+  for(j = 0; j < sdf_graph_tokens(g, edge); j++) {
+    if(scanf("%d", &input) != 1) {
+      return -1;
+    }
+    writeToken(sdf_graph_channel(g, edge), input);
   }
+  return 0;
 }
 
-void actor22SDF(int consum1, int consum2, int prod1,int prod2,
-                channel* ch_in1, channel* ch_in2, channel* ch_out1,channel* ch_out2,
-                void (*f) (token*, token*, token*, token*))
- {
- token input1[consum1], input2[consum2], output1[prod1],output2[prod2];
- int i;
-
- for(i = 0; i < consum1; i++) {
- readToken(*ch_in1, &input1[i]);
-    }
- for(i = 0; i < consum2; i++) {
- readToken(*ch_in2, &input2[i]);
-    }
- f(input1, input2, output1,output2);
- for(i = 0; i< prod1; i++) {
- writeToken(*ch_out1, output1[i]);
-
-    }
- for(i = 0; i< prod2; i++) {
- writeToken(*ch_out2, output2[i]);
-    }
-}
 /* Definition of functions within processes */
 
 /* Function in a */
 // a = actor11SDF 2 1 f_1
 //   where f_1 [ x ] [ y ] = [ x + y ]
-void f_1(token* in, token* out) {
-  out[0] = in[0] + in[1];
+void f_1(void** in, void** out) {
+  const token* in0 = in[0];
+  token* out0 = out[0];
+  out0[0] = in0[0] + in0[1];
+}
+
+/* Batch form of f_1: k firings at once, firing j on in[0] + 2*j */
+void f_1_batch(void** in, void** out, size_t k) {
+  const token* in0 = in[0];
+  token* out0 = out[0];
+  size_t j;
+  for(j = 0; j < k; j++) {
+    out0[j] = in0[2*j] + in0[2*j+1];
+  }
 }
 
 /* Function in b */
 // b = actor11SDF 1 2 f_2
 //   where f_2 [ x ] = [ x, x +1]
-void f_2(token* in, token* out) {
-  out[0] = in[0];
-  out[1] = in[0] + 1;
+void f_2(void** in, void** out) {
+  const token* in0 = in[0];
+  token* out0 = out[0];
+  out0[0] = in0[0];
+  out0[1] = in0[0] + 1;
 }
 
 /* Function in c */
 // c = actor21SDF (2 ,1) 1 f_3
 //   where f_3 [ x, y ] [ z ] = [ x+y+z ]
-void f_3(token* in1, token* in2, token* out) {
-  out[0] = in1[0] + in1[1] + in2[0];
+void f_3(void** in, void** out) {
+  const token* in0 = in[0];
+  const token* in1 = in[1];
+  token* out0 = out[0];
+  out0[0] = in0[0] + in0[1] + in1[0];
 }
 
 /* Function in d */
 // d = actor22SDF (2,1) (1,2) f_4
 //   where f_4 [ x,y ][z] = ([ x+y+z] ,[ x+y,x+y+z])
-void f_4(token* in1, token* in2, token* out1, token* out2) {
-  out1[0] = in1[0]+in1[1]+in2[0];
-  out2[0] = in1[0]+in1[1];
-  out2[1] = in1[0]+in1[1]+in2[0];
+void f_4(void** in, void** out) {
+  const token* in0 = in[0];
+  const token* in1 = in[1];
+  token* out0 = out[0];
+  token* out1 = out[1];
+  out0[0] = in0[0]+in0[1]+in1[0];
+  out1[0] = in0[0]+in0[1];
+  out1[1] = in0[0]+in0[1]+in1[0];
+}
+
+/* Graph inputs and outputs, set by makeGraph */
+int s_in1, s_in2, s_out;
+
+/* Describe the graph: ports are numbered in the order edges are added.
+   Shared by main and the benchmark driver (sdf_bench.c) */
+void makeGraph(sdf_graph* g) {
+  sdf_graph_init(g);
+  int a = sdf_graph_actor(g, "a", f_1);
+  int b = sdf_graph_actor(g, "b", f_2);
+  int c = sdf_graph_actor(g, "c", f_3);
+  int d = sdf_graph_actor(g, "d", f_4);
+  sdf_graph_batch(g, a, f_1_batch);
+
+  token s_4_init[] = {0, 0};
+  s_in1 = sdf_graph_input(g, a, 2);
+  s_in2 = sdf_graph_input(g, b, 1);
+  sdf_graph_edge(g, a, 1, c, 2, NULL, 0);     /* s_1 */
+  sdf_graph_edge(g, b, 2, d, 2, NULL, 0);     /* s_2 */
+  sdf_graph_edge(g, d, 1, c, 1, s_4_init, 2); /* s_4 */
+  sdf_graph_edge(g, c, 1, d, 1, NULL, 0);     /* s_3 */
+  s_out = sdf_graph_output(g, d, 2);
 }
 
 /* Main Program */
 
+#ifndef SDF_BENCH
 int main() {
-  token input1;
-  token input2;
   token output;
-  int i, j;
-
-  /* Create FIFO-Buffers for signals */
-  
-  /* Buffer s_in1: Size: 2 */
-  token* buffer_s_in1  = malloc(2 * sizeof(token));
-  channel s_in1 = createFIFO(buffer_s_in1, 2);
-  /* Buffer s_in2: Size: 1 */
-  token* buffer_s_in2  = malloc(1 * sizeof(token));
-  channel s_in2 = createFIFO(buffer_s_in2, 1);
-  /* Buffer s_out: Size: 2 */
-  token* buffer_s_out  = malloc(2 * sizeof(token));
-  channel s_out = createFIFO(buffer_s_out, 2);
-  /* Buffer s_1: Size: 2 */
-  token* buffer_s_1  = malloc(2 * sizeof(token));
-  channel s_1 = createFIFO(buffer_s_1, 1);
-  /* Buffer s_2: Size: 2 */
-  token* buffer_s_2  = malloc(2 * sizeof(token));
-  channel s_2 = createFIFO(buffer_s_2, 2);
-  /* Buffer s_3: Size: 1 */
-  token* buffer_s_3  = malloc(1 * sizeof(token));
-  channel s_3 = createFIFO(buffer_s_3, 1);
-  /* Buffer s_4: Size: 1 */
-  token* buffer_s_4  = malloc(1 * sizeof(token));
-  channel s_4 = createFIFO(buffer_s_4, 1);
-
-  /* Put initial tokens in channel s_4 */
-  writeToken(s_4, 0);
-  writeToken(s_4, 0);
-
-  /* Repeating Schedule: a,a,b,c,d */
+  size_t j;
+
+  sdf_graph g;
+  makeGraph(&g);
+
+  /* Repetition vector, schedule and buffer sizes */
+  if(sdf_graph_schedule(&g, SDF_SCHEDULE_MIN_BUFFER) != SDF_OK) {
+    printf("Graph is inconsistent or deadlocks\n");
+    return 1;
+  }
+  sdf_graph_print(&g, stdout);
+  sdf_graph_build(&g);
+
+  /* Repeating Schedule */
   while(1) {
-	 for(i = 0; i < 2; i++) {
-		/* Read input tokens */
-		printf("Read two input tokens for s_in1: ");
-		for(j = 0; j < 2; j++) {
-		  scanf("%d", &input1);
-		  writeToken(s_in1, input1);
-		}
-  		printf("Read one input token for s_in2: ");
-		for(j = 0; j < 1; j++) {
-		  scanf("%d", &input2);
-		  writeToken(s_in2, input2);
-		}  
-		/* a */
-		actor11SDF(2, 1, &s_in1, &s_1, f_1);
-		/* a */
-		actor11SDF(2, 1, &s_in1, &s_1, f_1);
-		/* b */
-		actor11SDF(1, 2, &s_in2, &s_2, f_2);
-		/* c */
-		actor21SDF(2, 1, 1, &s_1, &s_4, &s_3, f_3);
- 		/* d */
-		actor22SDF(2, 1, 1, 2, &s_2, &s_3, &s_4, &s_out, f_4);   
-		/* Write output tokens */
-		printf("Output: ");
-		for(j = 0; j< 2; j++) {
-		  readToken(s_out, &output);
-		  printf("%d ", output);
-      printf("\n");
-		}
-	 }
+    /* Read input tokens */
+    printf("Read %zu input tokens for s_in1: ", sdf_graph_tokens(&g, s_in1));
+    if(readInputs(&g, s_in1) != 0) {
+      break;
+    }
+    printf("Read %zu input tokens for s_in2: ", sdf_graph_tokens(&g, s_in2));
+    if(readInputs(&g, s_in2) != 0) {
+      break;
+    }
+    sdf_graph_iterate(&g);
+    /* Write output tokens */
+    printf("Output: ");
+    for(j = 0; j < sdf_graph_tokens(&g, s_out); j++) {
+      readToken(sdf_graph_channel(&g, s_out), &output);
+      printf("%d ", output);
+    }
+    printf("\n");
   }
+#ifdef SDF_STATS
+  sdf_stats_print(&g, stderr);
+#endif
+  sdf_graph_free(&g);
   return 0;
 }
+#endif
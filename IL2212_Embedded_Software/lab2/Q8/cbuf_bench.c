@@ -0,0 +1,112 @@
+/*
+ * Microbenchmark for the SDF channel indexing.
+ *
+ *   gcc -O2 -o cbuf_bench cbuf_bench.c
+ *
+ * Usage: ./cbuf_bench [capacity] [tokens]
+ *
+ * A producer/consumer pair is emulated on one thread, moving 'tokens'
+ * tokens through a channel of 'capacity' tokens, once with the per-token
+ * put/get and once with the range operations (half a buffer per call).
+ * Without a capacity it runs 1000 (modulo indexing) and 1024 (mask
+ * indexing), the two paths of circular_buffer.h.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "circular_buffer.h"
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Keeps the compiler from dropping the consumer side */
+static volatile token sink;
+
+static double bench_single(cbuf_handle_t cbuf, size_t tokens)
+{
+  size_t fill = circular_buf_capacity(cbuf) / 2 + 1;
+  size_t i, j;
+  token t, acc = 0;
+
+  double start = now();
+  for(i = 0; i < tokens; i += fill) {
+    for(j = 0; j < fill; j++) {
+      circular_buf_put(cbuf, (token) j);
+    }
+    for(j = 0; j < fill; j++) {
+      circular_buf_get(cbuf, &t);
+      acc += t;
+    }
+  }
+  double elapsed = now() - start;
+
+  sink = acc;
+  return elapsed;
+}
+
+static double bench_range(cbuf_handle_t cbuf, size_t tokens)
+{
+  size_t fill = circular_buf_capacity(cbuf) / 2 + 1;
+  token* window = malloc(fill * sizeof(token));
+  size_t i, j;
+  token acc = 0;
+
+  assert(window);
+  for(j = 0; j < fill; j++) {
+    window[j] = (token) j;
+  }
+
+  double start = now();
+  for(i = 0; i < tokens; i += fill) {
+    circular_buf_put_range(cbuf, window, fill);
+    circular_buf_get_range(cbuf, window, fill);
+    acc += window[fill - 1];
+  }
+  double elapsed = now() - start;
+
+  sink = acc;
+  free(window);
+  return elapsed;
+}
+
+static void bench(size_t capacity, size_t tokens)
+{
+  token* buffer = malloc(capacity * sizeof(token));
+  cbuf_handle_t cbuf = circular_buf_init(buffer, capacity);
+
+  double t_single = bench_single(cbuf, tokens);
+  circular_buf_reset(cbuf);
+  double t_range = bench_range(cbuf, tokens);
+
+  printf("%s, capacity %zu, %zu tokens\n", (capacity & (capacity - 1)) ? "modulo" : "pow2", capacity, tokens);
+  printf("  put/get        : %8.1f Mtokens/s\n", tokens / t_single * 1e-6);
+  printf("  put/get_range  : %8.1f Mtokens/s\n", tokens / t_range * 1e-6);
+
+  circular_buf_free(cbuf);
+  free(buffer);
+}
+
+int main(int argc, char** argv)
+{
+  size_t capacity = argc > 1 ? strtoul(argv[1], NULL, 0) : 0;
+  size_t tokens = argc > 2 ? strtoul(argv[2], NULL, 0) : 100000000;
+
+  if(argc > 1 && capacity == 0) {
+    printf("Capacity must be at least 1\n");
+    return 1;
+  }
+
+  if(capacity) {
+    bench(capacity, tokens);
+  }
+  else {
+    bench(1000, tokens);
+    bench(1024, tokens);
+  }
+  return 0;
+}
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include <assert.h>
 
 typedef int token;
@@ -15,11 +16,24 @@ typedef struct circular_buf_t circular_buf_t;
 /// Handle type, the way users interact with the API
 typedef circular_buf_t* cbuf_handle_t;
 
-/// Pass in a storage buffer and size, returns a circular buffer handle
+/// Pass in a storage buffer and size in tokens, returns a circular buffer handle
+/// Use a power-of-two size to get the mask-indexed fast path
 /// Requires: buffer is not NULL, size > 0
 /// Ensures: cbuf has been created and is returned in an empty state
 cbuf_handle_t circular_buf_init(token* buffer, size_t size);
 
+/// Typed channel: size elements of elem_size bytes each (uint8_t pixels,
+/// double gray values, char ASCII, or a frame descriptor passed by reference)
+/// The per-token put/get need elem_size == sizeof(token), the range and
+/// window functions work for any element size
+/// Requires: buffer is not NULL, size > 0, elem_size > 0
+/// Ensures: cbuf has been created and is returned in an empty state
+cbuf_handle_t circular_buf_init_elem(void* buffer, size_t size, size_t elem_size);
+
+/// Size in bytes of one element of the buffer
+/// Requires: cbuf is valid and created by circular_buf_init
+size_t circular_buf_elem_size(cbuf_handle_t cbuf);
+
 /// Free a circular buffer structure
 /// Requires: cbuf is valid and created by circular_buf_init
 /// Does not free data buffer; owner is responsible for that
@@ -64,22 +78,107 @@ size_t circular_buf_capacity(cbuf_handle_t cbuf);
 /// Returns the current number of elements in the buffer
 size_t circular_buf_size(cbuf_handle_t cbuf);
 
-//TODO: int circular_buf_get_range(circular_buf_t cbuf, token *data, size_t len);
-//TODO: int circular_buf_put_range(circular_buf_t cbuf, token * data, size_t len);
+/// Retrieve len values from the buffer in one operation
+/// At most two memcpy calls are made, one on each side of the wraparound
+/// Requires: cbuf is valid and created by circular_buf_init, data holds len elements
+/// Returns 0 on success, -1 if fewer than len elements are stored (nothing is read)
+int circular_buf_get_range(cbuf_handle_t cbuf, void * data, size_t len);
 
-#endif //CIRCULAR_BUFFER_H_
+/// Add len values to the buffer in one operation
+/// At most two memcpy calls are made, one on each side of the wraparound
+/// Requires: cbuf is valid and created by circular_buf_init, data holds len elements
+/// Returns 0 on success, -1 if there is no room for len elements (nothing is written)
+int circular_buf_put_range(cbuf_handle_t cbuf, const void * data, size_t len);
+
+/// Zero-copy read window: pointer to the len oldest elements in the storage
+/// Requires: cbuf is valid and created by circular_buf_init
+/// Returns NULL if fewer than len elements are stored or they wrap around
+/// the end of the storage; the elements stay in the buffer until circular_buf_commit_read
+const void* circular_buf_read_window(cbuf_handle_t cbuf, size_t len);
+
+/// Remove len elements from the buffer without copying them out
+/// Requires: cbuf is valid and created by circular_buf_init
+/// Returns 0 on success, -1 if fewer than len elements are stored
+int circular_buf_commit_read(cbuf_handle_t cbuf, size_t len);
+
+/// Zero-copy write window: pointer to len free slots in the storage
+/// Requires: cbuf is valid and created by circular_buf_init
+/// Returns NULL if there is no room for len elements or the slots wrap around
+/// the end of the storage; the elements are added by circular_buf_commit_write
+void* circular_buf_write_window(cbuf_handle_t cbuf, size_t len);
+
+/// Add len elements previously written through circular_buf_write_window
+/// Requires: cbuf is valid and created by circular_buf_init
+/// Returns 0 on success, -1 if there is no room for len elements
+int circular_buf_commit_write(cbuf_handle_t cbuf, size_t len);
+
+#ifdef SDF_STATS
+/// Channel counters, only kept when built with -DSDF_STATS
+typedef struct {
+	size_t peak;         // highest occupancy seen
+	uint64_t put;        // elements added
+	uint64_t got;        // elements removed
+	uint64_t overwrites; // elements lost by circular_buf_put on a full buffer
+	uint64_t underflows; // reads that found too few elements
+	uint64_t rejects;    // writes that found too little room
+} cbuf_stats_t;
+
+/// Copy out the counters of a buffer
+/// Requires: cbuf is valid and created by circular_buf_init
+void circular_buf_stats(cbuf_handle_t cbuf, cbuf_stats_t* stats);
+
+#define CBUF_STAT(x) do { x; } while(0)
+#else
+#define CBUF_STAT(x) do { } while(0)
+#endif
 
 // The definition of our circular buffer structure is hidden from the user
 struct circular_buf_t {
-	token * buffer;
-	size_t head;
-	size_t tail;
+	unsigned char * buffer;
+	size_t elem; // bytes per element
+	size_t head; // free-running counter if pow2, storage index otherwise
+	size_t tail; // free-running counter if pow2, storage index otherwise
 	size_t max; //of the buffer
-	bool full;
+	size_t mask; // max - 1, only valid if pow2
+	bool pow2;
+	bool full; // only used if !pow2
+#ifdef SDF_STATS
+	cbuf_stats_t stats;
+#endif
 };
 
 #pragma mark - Private Functions -
 
+#ifdef SDF_STATS
+// Account for a write of len elements, r is its result
+static void cbuf_stat_write(cbuf_handle_t cbuf, int r, size_t len)
+{
+	if(r)
+	{
+		cbuf->stats.rejects++;
+		return;
+	}
+
+	cbuf->stats.put += len;
+	if(circular_buf_size(cbuf) > cbuf->stats.peak)
+	{
+		cbuf->stats.peak = circular_buf_size(cbuf);
+	}
+}
+
+// Account for a read of len elements, r is its result
+static void cbuf_stat_read(cbuf_handle_t cbuf, int r, size_t len)
+{
+	if(r)
+	{
+		cbuf->stats.underflows++;
+		return;
+	}
+
+	cbuf->stats.got += len;
+}
+#endif
+
 static void advance_pointer(cbuf_handle_t cbuf)
 {
 	assert(cbuf);
@@ -103,17 +202,55 @@ static void retreat_pointer(cbuf_handle_t cbuf)
 	cbuf->tail = (cbuf->tail + 1) % cbuf->max;
 }
 
+// With a power-of-two capacity head and tail are free-running counters and
+// the storage index is taken with a mask: no division and no full flag per
+// token, and the occupancy is head - tail, also across the wrap of size_t.
+// Any other capacity keeps storage indices, the modulo and the full flag.
+
+// Storage index of a position, valid for both representations
+static inline size_t index_of(cbuf_handle_t cbuf, size_t pos)
+{
+	return cbuf->pow2 ? (pos & cbuf->mask) : pos;
+}
+
+// Move a position forward by len tokens, valid for both representations
+static inline size_t forward(cbuf_handle_t cbuf, size_t pos, size_t len)
+{
+	if(cbuf->pow2)
+	{
+		return pos + len;
+	}
+
+	pos += len;
+	if(pos >= cbuf->max)
+	{
+		pos -= cbuf->max;
+	}
+	return pos;
+}
+
 #pragma mark - APIs -
 
 cbuf_handle_t circular_buf_init(token* buffer, size_t size)
 {
-	assert(buffer && size);
+	return circular_buf_init_elem(buffer, size, sizeof(token));
+}
+
+cbuf_handle_t circular_buf_init_elem(void* buffer, size_t size, size_t elem_size)
+{
+	assert(buffer && size && elem_size);
 
 	cbuf_handle_t cbuf = malloc(sizeof(circular_buf_t));
 	assert(cbuf);
 
 	cbuf->buffer = buffer;
+	cbuf->elem = elem_size;
 	cbuf->max = size;
+#ifdef SDF_STATS
+	memset(&cbuf->stats, 0, sizeof(cbuf->stats));
+#endif
+	cbuf->pow2 = ((size & (size - 1)) == 0);
+	cbuf->mask = size - 1;
 	circular_buf_reset(cbuf);
 
 	assert(circular_buf_empty(cbuf));
@@ -140,6 +277,11 @@ size_t circular_buf_size(cbuf_handle_t cbuf)
 {
 	assert(cbuf);
 
+	if(cbuf->pow2)
+	{
+		return cbuf->head - cbuf->tail;
+	}
+
 	size_t size = cbuf->max;
 
 	if(!cbuf->full)
@@ -158,6 +300,13 @@ size_t circular_buf_size(cbuf_handle_t cbuf)
 	return size;
 }
 
+size_t circular_buf_elem_size(cbuf_handle_t cbuf)
+{
+	assert(cbuf);
+
+	return cbuf->elem;
+}
+
 size_t circular_buf_capacity(cbuf_handle_t cbuf)
 {
 	assert(cbuf);
@@ -167,43 +316,73 @@ size_t circular_buf_capacity(cbuf_handle_t cbuf)
 
 void circular_buf_put(cbuf_handle_t cbuf, token data)
 {
-	assert(cbuf && cbuf->buffer);
+	assert(cbuf && cbuf->buffer && cbuf->elem == sizeof(token));
+	CBUF_STAT(if(circular_buf_full(cbuf)) cbuf->stats.overwrites++);
+
+	if(cbuf->pow2)
+	{
+		((token*) cbuf->buffer)[cbuf->head & cbuf->mask] = data;
+		if(cbuf->head - cbuf->tail == cbuf->max)
+		{
+			cbuf->tail++;
+		}
+		cbuf->head++;
+		CBUF_STAT(cbuf_stat_write(cbuf, 0, 1));
+		return;
+	}
 
-    cbuf->buffer[cbuf->head] = data;
+    ((token*) cbuf->buffer)[cbuf->head] = data;
 
     advance_pointer(cbuf);
+    CBUF_STAT(cbuf_stat_write(cbuf, 0, 1));
 }
 
 int circular_buf_put2(cbuf_handle_t cbuf, token data)
 {
     int r = -1;
 
-    assert(cbuf && cbuf->buffer);
+    assert(cbuf && cbuf->buffer && cbuf->elem == sizeof(token));
 
     if(!circular_buf_full(cbuf))
     {
-        cbuf->buffer[cbuf->head] = data;
-        advance_pointer(cbuf);
+        if(cbuf->pow2)
+        {
+            ((token*) cbuf->buffer)[cbuf->head++ & cbuf->mask] = data;
+        }
+        else
+        {
+            ((token*) cbuf->buffer)[cbuf->head] = data;
+            advance_pointer(cbuf);
+        }
         r = 0;
     }
 
+    CBUF_STAT(cbuf_stat_write(cbuf, r, 1));
     return r;
 }
 
 int circular_buf_get(cbuf_handle_t cbuf, token * data)
 {
-    assert(cbuf && data && cbuf->buffer);
+    assert(cbuf && data && cbuf->buffer && cbuf->elem == sizeof(token));
 
     int r = -1;
 
     if(!circular_buf_empty(cbuf))
     {
-        *data = cbuf->buffer[cbuf->tail];
-        retreat_pointer(cbuf);
+        if(cbuf->pow2)
+        {
+            *data = ((token*) cbuf->buffer)[cbuf->tail++ & cbuf->mask];
+        }
+        else
+        {
+            *data = ((token*) cbuf->buffer)[cbuf->tail];
+            retreat_pointer(cbuf);
+        }
 
         r = 0;
     }
 
+    CBUF_STAT(cbuf_stat_read(cbuf, r, 1));
     return r;
 }
 
@@ -211,6 +390,11 @@ bool circular_buf_empty(cbuf_handle_t cbuf)
 {
 	assert(cbuf);
 
+	if(cbuf->pow2)
+	{
+		return cbuf->head == cbuf->tail;
+	}
+
     return (!cbuf->full && (cbuf->head == cbuf->tail));
 }
 
@@ -218,5 +402,154 @@ bool circular_buf_full(cbuf_handle_t cbuf)
 {
 	assert(cbuf);
 
+	if(cbuf->pow2)
+	{
+		return cbuf->head - cbuf->tail == cbuf->max;
+	}
+
     return cbuf->full;
 }
+
+int circular_buf_get_range(cbuf_handle_t cbuf, void * data, size_t len)
+{
+    assert(cbuf && data && cbuf->buffer);
+
+    if(len > circular_buf_size(cbuf))
+    {
+        CBUF_STAT(cbuf_stat_read(cbuf, -1, len));
+        return -1;
+    }
+
+    // First segment runs up to the end of the storage, second one wraps to the start
+    size_t idx = index_of(cbuf, cbuf->tail);
+    size_t first = cbuf->max - idx;
+    if(first > len)
+    {
+        first = len;
+    }
+
+    memcpy(data, cbuf->buffer + idx * cbuf->elem, first * cbuf->elem);
+    memcpy((unsigned char*) data + first * cbuf->elem, cbuf->buffer, (len - first) * cbuf->elem);
+
+    cbuf->tail = forward(cbuf, cbuf->tail, len);
+
+    if(len)
+    {
+        cbuf->full = false;
+    }
+
+    CBUF_STAT(cbuf_stat_read(cbuf, 0, len));
+    return 0;
+}
+
+int circular_buf_put_range(cbuf_handle_t cbuf, const void * data, size_t len)
+{
+    assert(cbuf && data && cbuf->buffer);
+
+    if(len > cbuf->max - circular_buf_size(cbuf))
+    {
+        CBUF_STAT(cbuf_stat_write(cbuf, -1, len));
+        return -1;
+    }
+
+    size_t idx = index_of(cbuf, cbuf->head);
+    size_t first = cbuf->max - idx;
+    if(first > len)
+    {
+        first = len;
+    }
+
+    memcpy(cbuf->buffer + idx * cbuf->elem, data, first * cbuf->elem);
+    memcpy(cbuf->buffer, (const unsigned char*) data + first * cbuf->elem, (len - first) * cbuf->elem);
+
+    cbuf->head = forward(cbuf, cbuf->head, len);
+
+    if(len && !cbuf->pow2)
+    {
+        cbuf->full = (cbuf->head == cbuf->tail);
+    }
+
+    CBUF_STAT(cbuf_stat_write(cbuf, 0, len));
+    return 0;
+}
+
+const void* circular_buf_read_window(cbuf_handle_t cbuf, size_t len)
+{
+    assert(cbuf && cbuf->buffer);
+
+    size_t idx = index_of(cbuf, cbuf->tail);
+
+    if(len > circular_buf_size(cbuf) || idx + len > cbuf->max)
+    {
+        return NULL;
+    }
+
+    return cbuf->buffer + idx * cbuf->elem;
+}
+
+int circular_buf_commit_read(cbuf_handle_t cbuf, size_t len)
+{
+    assert(cbuf);
+
+    if(len > circular_buf_size(cbuf))
+    {
+        CBUF_STAT(cbuf_stat_read(cbuf, -1, len));
+        return -1;
+    }
+
+    cbuf->tail = forward(cbuf, cbuf->tail, len);
+
+    if(len)
+    {
+        cbuf->full = false;
+    }
+
+    CBUF_STAT(cbuf_stat_read(cbuf, 0, len));
+    return 0;
+}
+
+void* circular_buf_write_window(cbuf_handle_t cbuf, size_t len)
+{
+    assert(cbuf && cbuf->buffer);
+
+    size_t idx = index_of(cbuf, cbuf->head);
+
+    if(len > cbuf->max - circular_buf_size(cbuf) || idx + len > cbuf->max)
+    {
+        return NULL;
+    }
+
+    return cbuf->buffer + idx * cbuf->elem;
+}
+
+int circular_buf_commit_write(cbuf_handle_t cbuf, size_t len)
+{
+    assert(cbuf);
+
+    if(len > cbuf->max - circular_buf_size(cbuf))
+    {
+        CBUF_STAT(cbuf_stat_write(cbuf, -1, len));
+        return -1;
+    }
+
+    cbuf->head = forward(cbuf, cbuf->head, len);
+
+    if(len && !cbuf->pow2)
+    {
+        cbuf->full = (cbuf->head == cbuf->tail);
+    }
+
+    CBUF_STAT(cbuf_stat_write(cbuf, 0, len));
+    return 0;
+}
+
+#ifdef SDF_STATS
+void circular_buf_stats(cbuf_handle_t cbuf, cbuf_stats_t* stats)
+{
+    assert(cbuf && stats);
+
+    *stats = cbuf->stats;
+}
+#endif
+
+#endif //CIRCULAR_BUFFER_H_
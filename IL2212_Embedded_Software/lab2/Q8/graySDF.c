@@ -43,9 +43,14 @@ asciiLevels = [' ','.',':','-','=','+','/','t','z','U','w','*','0','#','%','@']
 #include <stdio.h>
 #include <stdlib.h>
 #include "circular_buffer.h" /* defines data type token as uint8_t */
-
-/* Definition of the channel */
-typedef cbuf_handle_t channel;
+#include "sdf_actor.h" /* defines the channel and the generic SDF actor */
+#include "sdf_schedule.h" /* derives schedule and buffer sizes from the graph */
+#ifdef SDF_STATS
+#include "sdf_stats.h" /* channel and actor counters, build with -DSDF_STATS */
+#endif
+#ifdef SDF_PIPELINE
+#include "sdf_pipeline.h" /* one thread per actor, build with -pthread */
+#endif
 
 /* Definition of the functions 'readToken' and 'writeToken' */
 int readToken(channel ch, token* data) {
@@ -56,6 +61,19 @@ void writeToken(channel ch, token data) {
   circular_buf_put(ch, data);
 }
 
+/* Read the tokens of one iteration for a graph input, -1 at end of input */
+int readInputs(sdf_graph* g, int edge) {
+  token input;
+  size_t j;
+  for(j = 0; j < sdf_graph_tokens(g, edge); j++) {
+    if(scanf("%d", &input) != 1) {
+      return -1;
+    }
+    writeToken(sdf_graph_channel(g, edge), input);
+  }
+  return 0;
+}
+
 typedef struct {
     int r, g, b; // Red, Green, Blue components
 } pixel;
@@ -78,69 +96,102 @@ typedef struct {
     int dimY;    // Number of columns
 } ImageChar;
 
-/* Definition of function 'createFIFO' */
-channel createFIFO(token* buffer, size_t size){
-  return circular_buf_init(buffer, size);
+/* Definition of functions within processes */
+
+/* Functions of the system netlist run by main (see Q5.c for the model) */
+// p_1 = actor21SDF (2,1) 1 f_1
+//   where f_1 [x1,x2] [y] = [x1+x2+y]
+void f_1(void** in, void** out) {
+  const token* in0 = in[0];
+  const token* in1 = in[1];
+  token* out0 = out[0];
+  out0[0] = in0[0] + in0[1] + in1[0];
 }
 
-/* Definition of SDF actors */
+/* Batch forms: k firings at once, firing j on in[i] + j * rate */
+void f_1_batch(void** in, void** out, size_t k) {
+  const token* in0 = in[0];
+  const token* in1 = in[1];
+  token* out0 = out[0];
+  size_t j;
+  for(j = 0; j < k; j++) {
+    out0[j] = in0[2*j] + in0[2*j+1] + in1[j];
+  }
+}
 
-void actor11SDF(int consum, int prod,
-					 channel* ch_in, channel* ch_out,
-					 void (*f) (token*, token*))
-{
-  token input[consum], output[prod];
-  int i;
+// p_2 = actor12SDF 1 (1,1) f_2
+//   where f_2 [x] = ([x],[x+1])
+void f_2(void** in, void** out) {
+  const token* in0 = in[0];
+  token* out0 = out[0];
+  token* out1 = out[1];
+  out0[0] = in0[0];
+  out1[0] = in0[0] + 1;
+}
 
-  for(i = 0; i < consum; i++) {
-	 readToken(*ch_in, &input[i]);
-  }
-  f(input, output);
-  for(i = 0; i< prod; i++) {	 
-	 writeToken(*ch_out, output[i]);
+void f_2_batch(void** in, void** out, size_t k) {
+  const token* in0 = in[0];
+  token* out0 = out[0];
+  token* out1 = out[1];
+  size_t j;
+  for(j = 0; j < k; j++) {
+    out0[j] = in0[j];
+    out1[j] = in0[j] + 1;
   }
 }
 
-void actor12SDF(int consum, int prod1, int prod2,
-					 channel* ch_in, channel* ch_out1, channel* ch_out2,
-					 void (*f) (token*, token*, token*))
-{
-  token input[consum], output1[prod1], output2[prod2];
-  int i;
+// p_3 = actor21SDF (2,2) 2 f_3
+//   where f_3 [x1,x2] [y1,y2] = [x1+x2,y1+y2]
+void f_3(void** in, void** out) {
+  const token* in0 = in[0];
+  const token* in1 = in[1];
+  token* out0 = out[0];
+  out0[0] = in0[0] + in0[1];
+  out0[1] = in1[0] + in1[1];
+}
 
-  for(i = 0; i < consum; i++) {
-	 readToken(*ch_in, &input[i]);
-  }
-  f(input, output1, output2);
-  for(i = 0; i< prod1; i++) {	 
-	 writeToken(*ch_out1, output1[i]);
-  }
-  for(i = 0; i< prod2; i++) {	 
-	 writeToken(*ch_out2, output2[i]);
+// p_4 = actor12SDF 1 (3,1) f_4
+//   where f_4 [x] = ([x,x+1,x+2],[x])
+void f_4(void** in, void** out) {
+  const token* in0 = in[0];
+  token* out0 = out[0];
+  token* out1 = out[1];
+  out0[0] = in0[0];
+  out0[1] = in0[0] + 1;
+  out0[2] = in0[0] + 2;
+  out1[0] = in0[0];
+}
+
+void f_4_batch(void** in, void** out, size_t k) {
+  const token* in0 = in[0];
+  token* out0 = out[0];
+  token* out1 = out[1];
+  size_t j;
+  for(j = 0; j < k; j++) {
+    out0[3*j] = in0[j];
+    out0[3*j+1] = in0[j] + 1;
+    out0[3*j+2] = in0[j] + 2;
+    out1[j] = in0[j];
   }
 }
 
-void actor21SDF(int consum1, int consum2, int prod,
-					 channel* ch_in1, channel* ch_in2, channel* ch_out,
-					 void (*f) (token*, token*, token*))
-{
-  token input1[consum1], input2[consum2], output[prod];
-  int i;
+// p_5 = actor11SDF 1 1 f_5
+//   where f_5 [x] = [x+1]
+void f_5(void** in, void** out) {
+  const token* in0 = in[0];
+  token* out0 = out[0];
+  out0[0] = in0[0] + 1;
+}
 
-  for(i = 0; i < consum1; i++) {
-	 readToken(*ch_in1, &input1[i]);
-  }
-  for(i = 0; i < consum2; i++) {
-	 readToken(*ch_in2, &input2[i]);
-  }
-  f(input1, input2, output);
-  for(i = 0; i< prod; i++) {	 
-	 writeToken(*ch_out, output[i]);
+void f_5_batch(void** in, void** out, size_t k) {
+  const token* in0 = in[0];
+  token* out0 = out[0];
+  size_t j;
+  for(j = 0; j < k; j++) {
+    out0[j] = in0[j] + 1;
   }
 }
 
-/* Definition of functions within processes */
-
 /* Function in graySDF */
 // grayscale = mapMatrix (convert . fromVector) . mapV (groupV 3)
 //where
@@ -216,71 +267,111 @@ ImageChar asciiSDF(int dimX, int dimY, double* pixels, int length) {
     return toAsciiArt(&inputImage);
 }
 
+#ifdef SDF_PIPELINE
+/* Environment of the threaded build: inputs from stdin, outputs to stdout */
+void readTokens(void* ctx, void* data, size_t n) {
+  token* out = data;
+  size_t j;
+  (void) ctx;
+  for(j = 0; j < n; j++) {
+    if(scanf("%d", &out[j]) != 1) {
+      out[j] = 0;
+    }
+  }
+}
+
+void printTokens(void* ctx, const void* data, size_t n) {
+  const token* in = data;
+  size_t j;
+  (void) ctx;
+  printf("Output: ");
+  for(j = 0; j < n; j++) {
+    printf("%d ", in[j]);
+  }
+  printf("\n");
+}
+#endif
+
+/* Graph inputs and outputs, set by makeGraph */
+int s_in, s_out;
+
+/* Describe the graph: ports are numbered in the order edges are added.
+   Shared by main and the benchmark driver (sdf_bench.c) */
+void makeGraph(sdf_graph* g) {
+  sdf_graph_init(g);
+  int p_1 = sdf_graph_actor(g, "p_1", f_1);
+  int p_2 = sdf_graph_actor(g, "p_2", f_2);
+  int p_3 = sdf_graph_actor(g, "p_3", f_3);
+  int p_4 = sdf_graph_actor(g, "p_4", f_4);
+  int p_5 = sdf_graph_actor(g, "p_5", f_5);
+  sdf_graph_batch(g, p_1, f_1_batch);
+  sdf_graph_batch(g, p_2, f_2_batch);
+  sdf_graph_batch(g, p_4, f_4_batch);
+  sdf_graph_batch(g, p_5, f_5_batch);
+
+  token s_6_init[] = {0, 0};
+  s_in = sdf_graph_input(g, p_1, 2);
+  sdf_graph_edge(g, p_3, 2, p_1, 1, s_6_init, 2); /* s_6 */
+  sdf_graph_edge(g, p_1, 1, p_2, 1, NULL, 0);     /* s_1 */
+  sdf_graph_edge(g, p_2, 1, p_4, 1, NULL, 0);     /* s_2 */
+  sdf_graph_edge(g, p_2, 1, p_3, 2, NULL, 0);     /* s_3 */
+  sdf_graph_edge(g, p_5, 1, p_3, 2, NULL, 0);     /* s_5 */
+  s_out = sdf_graph_output(g, p_4, 3);
+  sdf_graph_edge(g, p_4, 1, p_5, 1, NULL, 0);     /* s_4 */
+}
+
 /* Main Program */
 
+#ifndef SDF_BENCH
 int main() {
-  token input;
   token output;
-  int i, j;
-
-  /* Create FIFO-Buffers for signals */
-  
-  /* Buffer s_in: Size: 3*dimX*dimY */
-  token* buffer_s_in  = malloc(3*dimX*dimY * sizeof(token));
-  channel s_in = createFIFO(buffer_s_in, 2);
-  /* Buffer s_out: Size: 3 */
-  token* buffer_s_out  = malloc(3 * sizeof(token));
-  channel s_out = createFIFO(buffer_s_out, 3);
-  /* Buffer s_1: Size: 1 */
-  token* buffer_s_1  = malloc(1 * sizeof(token));
-  channel s_1 = createFIFO(buffer_s_1, 1);
-  /* Buffer s_2: Size: 1 */
-  token* buffer_s_2  = malloc(1 * sizeof(token));
-  channel s_2 = createFIFO(buffer_s_2, 1);
-  /* Buffer s_3: Size: 2 */
-  token* buffer_s_3  = malloc(2 * sizeof(token));
-  channel s_3 = createFIFO(buffer_s_3, 2);
-  /* Buffer s_4: Size: 1 */
-  token* buffer_s_4  = malloc(1 * sizeof(token));
-  channel s_4 = createFIFO(buffer_s_4, 1);
-  /* Buffer s_5: Size: 2 */
-  token* buffer_s_5  = malloc(2 * sizeof(token));
-  channel s_5 = createFIFO(buffer_s_5, 2);
-  /* Buffer s_6: Size: 2 */
-  token* buffer_s_6  = malloc(2 * sizeof(token));
-  channel s_6 = createFIFO(buffer_s_6, 2);
-
-  /* Put initial tokens in channel s_6 */
-  writeToken(s_6, 0);
-  writeToken(s_6, 0);
-
-  /* Repeating Schedule: in->graySDF->AsciiSDF->out */
+  size_t j;
+
+  sdf_graph g;
+  makeGraph(&g);
+
+  /* Repetition vector, schedule and buffer sizes */
+  if(sdf_graph_schedule(&g, SDF_SCHEDULE_SINGLE_APPEARANCE) != SDF_OK) {
+    printf("Graph is inconsistent or deadlocks\n");
+    return 1;
+  }
+  sdf_graph_print(&g, stdout);
+
+#ifdef SDF_PIPELINE
+  /* Pipelined run: SDF_PIPELINE iterations, channels four times deeper */
+  sdf_pipeline p;
+  sdf_pipe_init(&p, &g, 4);
+  sdf_pipe_source(&p, s_in, readTokens, NULL);
+  sdf_pipe_sink(&p, s_out, printTokens, NULL);
+  sdf_pipe_run(&p, SDF_PIPELINE);
+  sdf_pipe_report(&p, stderr);
+  sdf_pipe_free(&p);
+  sdf_graph_free(&g);
+  return 0;
+#endif
+
+  sdf_graph_build(&g);
+
+  /* Repeating Schedule */
   while(1) {
-	 for(i = 0; i < 2; i++) {
-		/* Read input tokens */
-		printf("Read two input tokens: ");
-		for(j = 0; j < 2; j++) {
-		  scanf("%d", &input);
-		  writeToken(s_in, input);
-		}
-		/* P_1 */
-		actor21SDF(2, 1, 1, &s_in, &s_6, &s_1, f_1);
-		/* P_2 */
-		actor12SDF(1, 1, 1, &s_1, &s_2, &s_3, f_2);
-		/* P_4 */
-		actor12SDF(1, 3, 1, &s_2, &s_out, &s_4, f_4);
-		/* Write output tokens */
-		printf("Output: ");
-		for(j = 0; j< 3; j++) {
-		  readToken(s_out, &output);
-		  printf("%d ", output);
-		}
-		printf("\n");
-		/* P_5 */
-		actor11SDF(1, 1, &s_4, &s_5, f_5);
-	 }
-	 /* P_3 */
-	 actor21SDF(2, 2, 2, &s_3, &s_5, &s_6, f_3);	
+    /* Read input tokens */
+    printf("Read %zu input tokens: ", sdf_graph_tokens(&g, s_in));
+    if(readInputs(&g, s_in) != 0) {
+      break;
+    }
+    sdf_graph_iterate(&g);
+    /* Write output tokens */
+    printf("Output: ");
+    for(j = 0; j < sdf_graph_tokens(&g, s_out); j++) {
+      readToken(sdf_graph_channel(&g, s_out), &output);
+      printf("%d ", output);
+    }
+    printf("\n");
   }
+#ifdef SDF_STATS
+  sdf_stats_print(&g, stderr);
+#endif
+  sdf_graph_free(&g);
   return 0;
 }
+#endif
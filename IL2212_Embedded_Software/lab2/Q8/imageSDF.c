@@ -0,0 +1,168 @@
+/*
+ * graySDF -> asciiSDF image chain on the SDF runtime, in two flavours:
+ *
+ *  - pixel tokens on typed channels: uint8_t RGB samples, double gray
+ *    values and char ASCII pixels, each channel storing its own element
+ *    type instead of an int per sample,
+ *  - block tokens (-b): every channel carries one sdf_block pointer per
+ *    frame, the frames themselves live in fixed pools.
+ *
+ * gcc -pthread -o imageSDF imageSDF.c ppm_io.c
+ * ./imageSDF test.ppm [-b]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "ppm_io.h"
+#include "sdf_schedule.h"
+#include "sdf_block.h"
+
+/* Frame size, fixed for a run */
+static size_t dimX, dimY;
+
+/* Pools of the block-token graph */
+static sdf_block_pool gray_pool, ascii_pool;
+
+/* graySDF dimX dimY = actor11SDF (3 * dimX * dimY) (dimX * dimY) ... */
+void f_gray(void** in, void** out) {
+    const uint8_t* rgb = in[0];
+    double* gray = out[0];
+
+    for (size_t i = 0; i < dimX * dimY; i++) {
+        gray[i] = rgb_to_gray(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+    }
+}
+
+/* asciiSDF dimX dimY = actor11SDF (dimX * dimY) (dimX * dimY) ... */
+void f_ascii(void** in, void** out) {
+    const double* gray = in[0];
+    char* ascii = out[0];
+
+    for (size_t i = 0; i < dimX * dimY; i++) {
+        ascii[i] = num2char(gray[i]);
+    }
+}
+
+/* Same actors on block tokens: one frame in, one frame out, rate 1 */
+void f_gray_block(void** in, void** out) {
+    sdf_block* rgb = ((sdf_block**) in[0])[0];
+    sdf_block* gray = sdf_block_get(&gray_pool);
+    void* port_in[1] = { rgb->data };
+    void* port_out[1] = { gray->data };
+
+    f_gray(port_in, port_out);
+    gray->seq = rgb->seq;
+    sdf_block_release(rgb);
+    ((sdf_block**) out[0])[0] = gray;
+}
+
+void f_ascii_block(void** in, void** out) {
+    sdf_block* gray = ((sdf_block**) in[0])[0];
+    sdf_block* ascii = sdf_block_get(&ascii_pool);
+    void* port_in[1] = { gray->data };
+    void* port_out[1] = { ascii->data };
+
+    f_ascii(port_in, port_out);
+    ascii->seq = gray->seq;
+    sdf_block_release(gray);
+    ((sdf_block**) out[0])[0] = ascii;
+}
+
+static void print_ascii(const char* ascii) {
+    for (size_t i = 0; i < dimX * dimY; ++i) {
+        putchar(ascii[i]);
+        if ((i + 1) % dimX == 0) {
+            putchar('\n');
+        }
+    }
+}
+
+static size_t channel_bytes(sdf_graph* g) {
+    size_t bytes = 0;
+    for (size_t e = 0; e < g->n_edges; e++) {
+        bytes += g->edges[e].size * g->edges[e].elem;
+    }
+    return bytes;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s image.ppm [-b]\n", argv[0]);
+        return 1;
+    }
+    bool blocks = (argc > 2 && strcmp(argv[2], "-b") == 0);
+
+    ppmTy ppm = ppm_read(argv[1]);
+    dimX = ppm.w;
+    dimY = ppm.h;
+
+    sdf_graph g;
+    sdf_graph_init(&g);
+    int s_in, s_out;
+
+    if (!blocks) {
+        int gray = sdf_graph_actor(&g, "graySDF", f_gray);
+        int ascii = sdf_graph_actor(&g, "asciiSDF", f_ascii);
+        s_in = sdf_graph_typed_input(&g, gray, 3 * dimX * dimY, sizeof(uint8_t));
+        sdf_graph_typed_edge(&g, gray, dimX * dimY, ascii, dimX * dimY, sizeof(double), NULL, 0);
+        s_out = sdf_graph_typed_output(&g, ascii, dimX * dimY, sizeof(char));
+    } else {
+        int gray = sdf_graph_actor(&g, "graySDF", f_gray_block);
+        int ascii = sdf_graph_actor(&g, "asciiSDF", f_ascii_block);
+        s_in = sdf_graph_typed_input(&g, gray, 1, sizeof(sdf_block*));
+        sdf_graph_typed_edge(&g, gray, 1, ascii, 1, sizeof(sdf_block*), NULL, 0);
+        s_out = sdf_graph_typed_output(&g, ascii, 1, sizeof(sdf_block*));
+    }
+
+    if (sdf_graph_schedule(&g, SDF_SCHEDULE_SINGLE_APPEARANCE) != SDF_OK) {
+        printf("Graph is inconsistent or deadlocks\n");
+        return 1;
+    }
+    sdf_graph_build(&g);
+
+    if (!blocks) {
+        uint8_t* rgb = malloc(3 * dimX * dimY);
+        char* ascii = malloc(dimX * dimY);
+        for (size_t i = 0; i < 3 * dimX * dimY; i++) {
+            rgb[i] = (uint8_t) ppm.data[i];
+        }
+
+        circular_buf_put_range(sdf_graph_channel(&g, s_in), rgb, 3 * dimX * dimY);
+        sdf_graph_iterate(&g);
+        circular_buf_get_range(sdf_graph_channel(&g, s_out), ascii, dimX * dimY);
+        print_ascii(ascii);
+
+        free(rgb);
+        free(ascii);
+    } else {
+        sdf_block_pool rgb_pool;
+        sdf_block_pool_init(&rgb_pool, 1, 3 * dimX, dimY, sizeof(uint8_t));
+        sdf_block_pool_init(&gray_pool, 1, dimX, dimY, sizeof(double));
+        sdf_block_pool_init(&ascii_pool, 1, dimX, dimY, sizeof(char));
+
+        sdf_block* rgb = sdf_block_get(&rgb_pool);
+        for (size_t i = 0; i < 3 * dimX * dimY; i++) {
+            ((uint8_t*) rgb->data)[i] = (uint8_t) ppm.data[i];
+        }
+        rgb->seq = 0;
+
+        sdf_block* ascii;
+        circular_buf_put_range(sdf_graph_channel(&g, s_in), &rgb, 1);
+        sdf_graph_iterate(&g);
+        circular_buf_get_range(sdf_graph_channel(&g, s_out), &ascii, 1);
+        print_ascii(ascii->data);
+        sdf_block_release(ascii);
+
+        sdf_block_pool_free(&rgb_pool);
+        sdf_block_pool_free(&gray_pool);
+        sdf_block_pool_free(&ascii_pool);
+    }
+
+    fprintf(stderr, "%s tokens: %zu bytes of channel storage\n",
+            blocks ? "block" : "pixel", channel_bytes(&g));
+
+    sdf_graph_free(&g);
+    free(ppm.data);
+    return 0;
+}
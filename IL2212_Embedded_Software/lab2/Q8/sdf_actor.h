@@ -0,0 +1,518 @@
+#ifndef SDF_ACTOR_H_
+#define SDF_ACTOR_H_
+
+/*
+ * Generic SDF actor with any number of input and output ports.
+ *
+ * Replaces the hand-written actor11SDF/actor12SDF/actor21SDF/actor22SDF
+ * wrappers. An actor is described once (ports, rates, function) and then
+ * fired by sdf_fire. The actor function receives one pointer per port:
+ *
+ *   void f(void** in, void** out)
+ *
+ * in[i] points to the rate elements consumed on input port i, out[j] to
+ * the rate slots to fill on output port j, each of the element type of
+ * the port's channel (token, uint8_t, double, char, sdf_block*, ...), so
+ * the function starts by giving them their type:
+ *
+ *   const uint8_t* rgb = in[0]; double* gray = out[0];
+ *
+ * Whenever the window is contiguous
+ * in the channel storage the pointer goes straight into the channel, so
+ * no token is copied. Only a window wrapping around the end of the
+ * storage goes through the actor's scratch buffer, which is allocated
+ * once on the heap (no stack VLAs, so image-sized rates are fine).
+ *
+ * An actor may also get a batch form of its function,
+ *
+ *   void fb(void** in, void** out, size_t k)
+ *
+ * doing k consecutive firings in one call: port i then holds k windows of
+ * rate elements back to back, firing j using in[i] + j * rate. sdf_fire_n
+ * uses it when the schedule fires the actor several times in a row, which
+ * saves k - 1 calls and window setups and gives the compiler a loop over
+ * the firings to vectorise.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "circular_buffer.h" /* defines data type token */
+
+/* Definition of the channel */
+typedef cbuf_handle_t channel;
+
+#define SDF_MAX_PORTS 8
+
+/// Actor function, one element window per port
+typedef void (*sdf_func)(void** in, void** out);
+
+/// Batch actor function, k windows of rate elements per port
+typedef void (*sdf_batch_func)(void** in, void** out, size_t k);
+
+#ifdef SDF_STATS
+#define SDF_HIST_BUCKETS 32
+
+/// Firing counters of an actor, only kept when built with -DSDF_STATS
+/// Times are in sdf_cycles() units: TSC cycles on x86, counter ticks on
+/// AArch64, nanoseconds elsewhere
+typedef struct {
+	uint64_t firings;
+	uint64_t cycles;     // all firings
+	uint64_t cycles_min; // one firing
+	uint64_t cycles_max; // one firing
+	uint64_t hist[SDF_HIST_BUCKETS]; // firings taking [2^i, 2^(i+1)) cycles
+} sdf_actor_stats_t;
+#endif
+
+/// A port connects an actor to a channel with a fixed rate
+typedef struct {
+	channel ch;
+	size_t rate;
+} sdf_port;
+
+/// Actor descriptor
+typedef struct {
+	const char* name;
+	sdf_func f;
+	sdf_batch_func fb; // NULL if the actor has no batch form
+	size_t n_in;
+	size_t n_out;
+	sdf_port in[SDF_MAX_PORTS];
+	sdf_port out[SDF_MAX_PORTS];
+	unsigned char* scratch; // wraparound fallback, one slot per element of all ports
+	unsigned char* batch_scratch; // same for batches, grown on demand
+	size_t batch_bytes;
+#ifdef SDF_STATS
+	sdf_actor_stats_t stats;
+#endif
+} sdf_actor;
+
+/// Initialise an actor without ports
+/// Requires: a is not NULL, f is not NULL
+void sdf_actor_init(sdf_actor* a, const char* name, sdf_func f);
+
+/// Append an input/output port, ports are numbered in the order they are added
+/// Requires: less than SDF_MAX_PORTS ports of that direction, rate > 0,
+///           ch not already connected to another port of the same direction
+void sdf_actor_input(sdf_actor* a, channel ch, size_t rate);
+void sdf_actor_output(sdf_actor* a, channel ch, size_t rate);
+
+/// Give the actor a batch form of its function
+/// Requires: fb computes the same as k calls of f
+void sdf_actor_batch(sdf_actor* a, sdf_batch_func fb);
+
+/// Free the scratch buffer of an actor. Channels are not touched
+void sdf_actor_free(sdf_actor* a);
+
+/// Check if every input holds enough tokens and every output enough room
+/// Returns true if sdf_fire would succeed
+bool sdf_can_fire(sdf_actor* a);
+
+/// Fire the actor once: consume, compute, produce
+/// Returns 0 on success, -1 if the actor cannot fire (nothing is consumed)
+int sdf_fire(sdf_actor* a);
+
+/// Check if the actor can fire k times without any other actor firing
+bool sdf_can_fire_n(sdf_actor* a, size_t k);
+
+/// Fire the actor k times in a row, with one call of the batch function
+/// when the actor has one and is not on a self-loop, else k calls of f
+/// Returns 0 on success, -1 if the actor cannot fire k times
+int sdf_fire_n(sdf_actor* a, size_t k);
+
+#pragma mark - Private Functions -
+
+#ifdef SDF_STATS
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+static inline uint64_t sdf_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#elif defined(__aarch64__)
+	uint64_t t;
+	__asm__ volatile("mrs %0, cntvct_el0" : "=r"(t));
+	return t;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+// Account for k firings that took 'cycles' together
+static void sdf_stat_fire(sdf_actor* a, uint64_t cycles, size_t k)
+{
+	uint64_t each = cycles / k;
+	size_t bucket = 0;
+
+	while(bucket < SDF_HIST_BUCKETS - 1 && (each >> (bucket + 1)))
+	{
+		bucket++;
+	}
+
+	if(a->stats.firings == 0 || each < a->stats.cycles_min)
+	{
+		a->stats.cycles_min = each;
+	}
+	if(each > a->stats.cycles_max)
+	{
+		a->stats.cycles_max = each;
+	}
+	a->stats.firings += k;
+	a->stats.cycles += cycles;
+	a->stats.hist[bucket] += k;
+}
+
+#define SDF_STAT(x) do { x; } while(0)
+#else
+#define SDF_STAT(x) do { } while(0)
+#endif
+
+// Tokens the actor itself consumes from ch in one firing
+static size_t sdf_consumed_from(sdf_actor* a, channel ch)
+{
+	size_t i, n = 0;
+
+	for(i = 0; i < a->n_in; i++)
+	{
+		if(a->in[i].ch == ch)
+		{
+			n += a->in[i].rate;
+		}
+	}
+
+	return n;
+}
+
+// Does the actor both read and write one of its channels?
+static bool sdf_self_loop(sdf_actor* a)
+{
+	size_t i;
+
+	for(i = 0; i < a->n_out; i++)
+	{
+		if(sdf_consumed_from(a, a->out[i].ch))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static unsigned char* sdf_scratch(sdf_actor* a)
+{
+	if(!a->scratch)
+	{
+		size_t i, total = 0;
+
+		for(i = 0; i < a->n_in; i++)
+		{
+			total += a->in[i].rate * circular_buf_elem_size(a->in[i].ch);
+		}
+		for(i = 0; i < a->n_out; i++)
+		{
+			total += a->out[i].rate * circular_buf_elem_size(a->out[i].ch);
+		}
+
+		a->scratch = malloc(total);
+		assert(a->scratch);
+	}
+
+	return a->scratch;
+}
+
+#pragma mark - APIs -
+
+void sdf_actor_init(sdf_actor* a, const char* name, sdf_func f)
+{
+	assert(a && f);
+
+	a->name = name;
+	a->f = f;
+	a->fb = NULL;
+	a->n_in = 0;
+	a->n_out = 0;
+	a->scratch = NULL;
+	a->batch_scratch = NULL;
+	a->batch_bytes = 0;
+#ifdef SDF_STATS
+	memset(&a->stats, 0, sizeof(a->stats));
+#endif
+}
+
+void sdf_actor_batch(sdf_actor* a, sdf_batch_func fb)
+{
+	assert(a);
+
+	a->fb = fb;
+}
+
+void sdf_actor_input(sdf_actor* a, channel ch, size_t rate)
+{
+	assert(a && ch && rate && a->n_in < SDF_MAX_PORTS && !a->scratch);
+	assert(sdf_consumed_from(a, ch) == 0);
+
+	a->in[a->n_in].ch = ch;
+	a->in[a->n_in].rate = rate;
+	a->n_in++;
+}
+
+void sdf_actor_output(sdf_actor* a, channel ch, size_t rate)
+{
+	size_t i;
+
+	assert(a && ch && rate && a->n_out < SDF_MAX_PORTS && !a->scratch);
+	for(i = 0; i < a->n_out; i++)
+	{
+		assert(a->out[i].ch != ch);
+	}
+
+	a->out[a->n_out].ch = ch;
+	a->out[a->n_out].rate = rate;
+	a->n_out++;
+}
+
+void sdf_actor_free(sdf_actor* a)
+{
+	assert(a);
+
+	free(a->scratch);
+	free(a->batch_scratch);
+	a->scratch = NULL;
+	a->batch_scratch = NULL;
+	a->batch_bytes = 0;
+}
+
+bool sdf_can_fire(sdf_actor* a)
+{
+	return sdf_can_fire_n(a, 1);
+}
+
+bool sdf_can_fire_n(sdf_actor* a, size_t k)
+{
+	size_t i;
+
+	assert(a);
+
+	for(i = 0; i < a->n_in; i++)
+	{
+		if(circular_buf_size(a->in[i].ch) < k * a->in[i].rate)
+		{
+			return false;
+		}
+	}
+
+	// Tokens consumed from a self-loop free room for the tokens produced on it
+	for(i = 0; i < a->n_out; i++)
+	{
+		channel ch = a->out[i].ch;
+		size_t room = circular_buf_capacity(ch) - circular_buf_size(ch) + k * sdf_consumed_from(a, ch);
+
+		if(room < k * a->out[i].rate)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int sdf_fire(sdf_actor* a)
+{
+	void* in[SDF_MAX_PORTS];
+	void* out[SDF_MAX_PORTS];
+	bool in_direct[SDF_MAX_PORTS];
+	bool out_direct[SDF_MAX_PORTS];
+	size_t i;
+
+	if(!sdf_can_fire(a))
+	{
+		return -1;
+	}
+
+#ifdef SDF_STATS
+	uint64_t start = sdf_cycles();
+#endif
+
+	unsigned char* scratch = sdf_scratch(a);
+
+	// Inputs: point into the channel, or copy a wrapped window out (and consume it)
+	for(i = 0; i < a->n_in; i++)
+	{
+		in[i] = (void*) circular_buf_read_window(a->in[i].ch, a->in[i].rate);
+		in_direct[i] = (in[i] != NULL);
+
+		if(!in_direct[i])
+		{
+			in[i] = scratch;
+			circular_buf_get_range(a->in[i].ch, in[i], a->in[i].rate);
+		}
+		scratch += a->in[i].rate * circular_buf_elem_size(a->in[i].ch);
+	}
+
+	// Outputs: free slots in the channel never overlap the inputs still held there
+	for(i = 0; i < a->n_out; i++)
+	{
+		out[i] = circular_buf_write_window(a->out[i].ch, a->out[i].rate);
+		out_direct[i] = (out[i] != NULL);
+
+		if(!out_direct[i])
+		{
+			out[i] = scratch;
+		}
+		scratch += a->out[i].rate * circular_buf_elem_size(a->out[i].ch);
+	}
+
+	a->f(in, out);
+
+	for(i = 0; i < a->n_out; i++)
+	{
+		if(out_direct[i])
+		{
+			circular_buf_commit_write(a->out[i].ch, a->out[i].rate);
+		}
+	}
+
+	for(i = 0; i < a->n_in; i++)
+	{
+		if(in_direct[i])
+		{
+			circular_buf_commit_read(a->in[i].ch, a->in[i].rate);
+		}
+	}
+
+	// Wrapped outputs last, once the consumed tokens made room for them
+	for(i = 0; i < a->n_out; i++)
+	{
+		if(!out_direct[i])
+		{
+			circular_buf_put_range(a->out[i].ch, out[i], a->out[i].rate);
+		}
+	}
+
+	SDF_STAT(sdf_stat_fire(a, sdf_cycles() - start, 1));
+
+	return 0;
+}
+
+int sdf_fire_n(sdf_actor* a, size_t k)
+{
+	void* in[SDF_MAX_PORTS];
+	void* out[SDF_MAX_PORTS];
+	bool in_direct[SDF_MAX_PORTS];
+	bool out_direct[SDF_MAX_PORTS];
+	size_t i, t, bytes = 0;
+
+	assert(a);
+
+	// A self-loop feeds firing j + 1 with the output of firing j: no batching
+	if(!a->fb || k < 2 || sdf_self_loop(a))
+	{
+		for(t = 0; t < k; t++)
+		{
+			if(sdf_fire(a) != 0)
+			{
+				return -1;
+			}
+		}
+		return 0;
+	}
+
+	if(!sdf_can_fire_n(a, k))
+	{
+		return -1;
+	}
+
+#ifdef SDF_STATS
+	uint64_t start = sdf_cycles();
+#endif
+
+	for(i = 0; i < a->n_in; i++)
+	{
+		bytes += k * a->in[i].rate * circular_buf_elem_size(a->in[i].ch);
+	}
+	for(i = 0; i < a->n_out; i++)
+	{
+		bytes += k * a->out[i].rate * circular_buf_elem_size(a->out[i].ch);
+	}
+	if(bytes > a->batch_bytes)
+	{
+		free(a->batch_scratch);
+		a->batch_scratch = malloc(bytes);
+		assert(a->batch_scratch);
+		a->batch_bytes = bytes;
+	}
+
+	unsigned char* scratch = a->batch_scratch;
+
+	// Same steps as sdf_fire, with k windows per port
+	for(i = 0; i < a->n_in; i++)
+	{
+		size_t len = k * a->in[i].rate;
+
+		in[i] = (void*) circular_buf_read_window(a->in[i].ch, len);
+		in_direct[i] = (in[i] != NULL);
+		if(!in_direct[i])
+		{
+			in[i] = scratch;
+			circular_buf_get_range(a->in[i].ch, in[i], len);
+		}
+		scratch += len * circular_buf_elem_size(a->in[i].ch);
+	}
+
+	for(i = 0; i < a->n_out; i++)
+	{
+		size_t len = k * a->out[i].rate;
+
+		out[i] = circular_buf_write_window(a->out[i].ch, len);
+		out_direct[i] = (out[i] != NULL);
+		if(!out_direct[i])
+		{
+			out[i] = scratch;
+		}
+		scratch += len * circular_buf_elem_size(a->out[i].ch);
+	}
+
+	a->fb(in, out, k);
+
+	for(i = 0; i < a->n_out; i++)
+	{
+		if(out_direct[i])
+		{
+			circular_buf_commit_write(a->out[i].ch, k * a->out[i].rate);
+		}
+	}
+
+	for(i = 0; i < a->n_in; i++)
+	{
+		if(in_direct[i])
+		{
+			circular_buf_commit_read(a->in[i].ch, k * a->in[i].rate);
+		}
+	}
+
+	for(i = 0; i < a->n_out; i++)
+	{
+		if(!out_direct[i])
+		{
+			circular_buf_put_range(a->out[i].ch, out[i], k * a->out[i].rate);
+		}
+	}
+
+	SDF_STAT(sdf_stat_fire(a, sdf_cycles() - start, k));
+
+	return 0;
+}
+
+#endif //SDF_ACTOR_H_
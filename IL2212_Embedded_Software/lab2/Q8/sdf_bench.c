@@ -0,0 +1,364 @@
+/*
+ * Non-interactive benchmark driver for the lab2 SDF graphs.
+ *
+ * The graph comes from the program given by GRAPH, which provides
+ * makeGraph() and leaves out its interactive main when SDF_BENCH is set:
+ *
+ *   gcc -O2 -pthread -DGRAPH='"graySDF.c"' -o bench_gray sdf_bench.c
+ *   gcc -O2 -pthread -I. -DGRAPH='"../Q5/Q5.c"' -o bench_q5 sdf_bench.c
+ *
+ * Usage: ./bench_gray [-n iterations] [-i tokens.txt] [-s sas|min]
+ *                     [-t depth] [-f csv|json] [-o results]
+ *
+ *   -n  graph iterations to run (default 1000000)
+ *   -i  whitespace separated input tokens, used in a loop; without it
+ *       the inputs are 0, 1, 2, ... modulo 256
+ *   -s  schedule, single appearance (default) or minimum buffer
+ *   -t  run on the threaded executor with channels 'depth' times the
+ *       sequential size, instead of the sequential schedule
+ *   -f  result format (default csv)
+ *   -o  append the results to a file instead of printing them
+ *
+ * The sequential runtime is measured twice: once through
+ * sdf_graph_iterate for iterations/s and tokens/s, once timing every run
+ * of the schedule for ns/firing per actor. The threaded executor reports
+ * ns/firing from each thread's compute time. Tokens/s counts the tokens
+ * crossing every channel. The checksum of the outputs must not change
+ * between runtime variants.
+ */
+
+#define SDF_BENCH
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef GRAPH
+#define GRAPH "graySDF.c"
+#endif
+#include GRAPH
+#include "sdf_pipeline.h"
+
+/* Iterations of input generated up front and replayed */
+#define BENCH_INPUT_ITERATIONS 1024
+
+typedef struct {
+  const char* mode;
+  const char* schedule;
+  size_t iterations;
+  double seconds;
+  double tokens_per_iteration;
+  uint64_t checksum;
+  uint64_t firings[SDF_MAX_ACTORS];
+  double ns[SDF_MAX_ACTORS];
+} bench_result;
+
+static token* inputs[SDF_MAX_EDGES];   /* replayed input tokens per graph input */
+static size_t input_pos[SDF_MAX_EDGES];
+static uint64_t checksum;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void load_inputs(sdf_graph* g, const char* file)
+{
+  token* data = NULL;
+  size_t len = 0, cap = 0, e, j;
+
+  if(file) {
+    FILE* fp = fopen(file, "r");
+    token t;
+    if(!fp) {
+      printf("cannot open the file: %s\n", file);
+      exit(1);
+    }
+    while(fscanf(fp, "%d", &t) == 1) {
+      if(len == cap) {
+        cap = cap ? 2 * cap : 1024;
+        data = realloc(data, cap * sizeof(token));
+      }
+      data[len++] = t;
+    }
+    fclose(fp);
+    if(len == 0) {
+      printf("No tokens in %s\n", file);
+      exit(1);
+    }
+  }
+
+  size_t k = 0;
+  for(e = 0; e < g->n_edges; e++) {
+    if(g->edges[e].src != SDF_EXTERNAL) {
+      continue;
+    }
+    size_t n = BENCH_INPUT_ITERATIONS * sdf_graph_tokens(g, (int) e);
+    inputs[e] = malloc(n * sizeof(token));
+    for(j = 0; j < n; j++, k++) {
+      inputs[e][j] = len ? data[k % len] : (token) (k & 0xff);
+    }
+  }
+
+  free(data);
+}
+
+static const token* next_inputs(sdf_graph* g, int e)
+{
+  size_t n = sdf_graph_tokens(g, e);
+  const token* t = inputs[e] + input_pos[e] * n;
+  input_pos[e] = (input_pos[e] + 1) % BENCH_INPUT_ITERATIONS;
+  return t;
+}
+
+static void consume_outputs(const token* t, size_t n)
+{
+  size_t j;
+  for(j = 0; j < n; j++) {
+    checksum = (checksum ^ (uint32_t) t[j]) * 1099511628211ull;
+  }
+}
+
+typedef struct {
+  sdf_graph* g;
+  int edge;
+} bench_port;
+
+/* Environment of the threaded executor */
+
+static void port_source(void* ctx, void* out, size_t n)
+{
+  bench_port* port = ctx;
+  memcpy(out, next_inputs(port->g, port->edge), n * sizeof(token));
+}
+
+static void port_sink(void* ctx, const void* in, size_t n)
+{
+  (void) ctx;
+  consume_outputs(in, n);
+}
+
+static void feed(sdf_graph* g)
+{
+  size_t e;
+
+  for(e = 0; e < g->n_edges; e++) {
+    if(g->edges[e].src == SDF_EXTERNAL) {
+      circular_buf_put_range(g->edges[e].ch, next_inputs(g, (int) e), sdf_graph_tokens(g, (int) e));
+    }
+  }
+}
+
+static void drain(sdf_graph* g, token* sink)
+{
+  size_t e;
+
+  for(e = 0; e < g->n_edges; e++) {
+    if(g->edges[e].dst == SDF_EXTERNAL) {
+      size_t n = sdf_graph_tokens(g, (int) e);
+      circular_buf_get_range(g->edges[e].ch, sink, n);
+      consume_outputs(sink, n);
+    }
+  }
+}
+
+static void bench_sequential(sdf_graph* g, size_t iterations, bench_result* r)
+{
+  size_t it, i, e, max_out = 1;
+  double t0, t1;
+
+  for(e = 0; e < g->n_edges; e++) {
+    if(g->edges[e].dst == SDF_EXTERNAL && sdf_graph_tokens(g, (int) e) > max_out) {
+      max_out = sdf_graph_tokens(g, (int) e);
+    }
+  }
+  token* sink = malloc(max_out * sizeof(token));
+
+  sdf_graph_build(g);
+
+  /* Throughput */
+  t0 = now();
+  for(it = 0; it < iterations; it++) {
+    feed(g);
+    if(sdf_graph_iterate(g) != 0) {
+      printf("Actor could not fire in iteration %zu\n", it);
+      exit(1);
+    }
+    drain(g, sink);
+  }
+  r->seconds = now() - t0;
+  r->checksum = checksum;
+
+  /* Profile: time each run of the schedule */
+  double spent[SDF_MAX_ACTORS] = {0};
+  for(it = 0; it < iterations; it++) {
+    feed(g);
+    for(i = 0; i < g->n_firings; i++) {
+      int a = g->schedule[i].actor;
+      t0 = now();
+      sdf_fire_n(&g->actors[a], g->schedule[i].count);
+      t1 = now();
+      spent[a] += t1 - t0;
+    }
+    drain(g, sink);
+  }
+
+  for(i = 0; i < g->n_actors; i++) {
+    r->firings[i] = (uint64_t) g->q[i] * iterations;
+    r->ns[i] = r->firings[i] ? spent[i] * 1e9 / r->firings[i] : 0.0;
+  }
+
+  free(sink);
+}
+
+static void bench_threaded(sdf_graph* g, size_t iterations, size_t depth, bench_result* r)
+{
+  bench_port ports[SDF_MAX_EDGES];
+  sdf_pipeline p;
+  size_t e, i;
+
+  sdf_pipe_init(&p, g, depth);
+  for(e = 0; e < g->n_edges; e++) {
+    ports[e].g = g;
+    ports[e].edge = (int) e;
+    if(g->edges[e].src == SDF_EXTERNAL) {
+      sdf_pipe_source(&p, (int) e, port_source, &ports[e]);
+    }
+    if(g->edges[e].dst == SDF_EXTERNAL) {
+      sdf_pipe_sink(&p, (int) e, port_sink, &ports[e]);
+    }
+  }
+
+  sdf_pipe_run(&p, iterations);
+  r->seconds = p.wall_ns * 1e-9;
+  r->checksum = checksum;
+
+  for(i = 0; i < p.n_workers; i++) {
+    sdf_worker* w = &p.workers[i];
+    if(w->actor != SDF_EXTERNAL) {
+      r->firings[w->actor] = w->firings;
+      r->ns[w->actor] = w->firings ? (double) w->busy_ns / w->firings : 0.0;
+    }
+  }
+
+  sdf_pipe_free(&p);
+}
+
+static void write_csv(FILE* out, sdf_graph* g, bench_result* r, bool header)
+{
+  size_t a;
+
+  if(header) {
+    fprintf(out, "graph,mode,schedule,iterations,seconds,iterations_per_s,tokens_per_s,checksum,actor,firings,ns_per_firing\n");
+  }
+  for(a = 0; a < g->n_actors; a++) {
+    fprintf(out, "%s,%s,%s,%zu,%.6f,%.1f,%.1f,%016llx,%s,%llu,%.2f\n", GRAPH, r->mode, r->schedule,
+            r->iterations, r->seconds, r->iterations / r->seconds,
+            r->iterations * r->tokens_per_iteration / r->seconds,
+            (unsigned long long) r->checksum, g->actors[a].name,
+            (unsigned long long) r->firings[a], r->ns[a]);
+  }
+}
+
+static void write_json(FILE* out, sdf_graph* g, bench_result* r)
+{
+  size_t a;
+
+  fprintf(out, "{\"graph\": \"%s\", \"mode\": \"%s\", \"schedule\": \"%s\", \"iterations\": %zu, "
+          "\"seconds\": %.6f, \"iterations_per_s\": %.1f, \"tokens_per_s\": %.1f, \"checksum\": \"%016llx\", \"actors\": [",
+          GRAPH, r->mode, r->schedule, r->iterations, r->seconds, r->iterations / r->seconds,
+          r->iterations * r->tokens_per_iteration / r->seconds, (unsigned long long) r->checksum);
+  for(a = 0; a < g->n_actors; a++) {
+    fprintf(out, "%s{\"name\": \"%s\", \"firings\": %llu, \"ns_per_firing\": %.2f}", a ? ", " : "",
+            g->actors[a].name, (unsigned long long) r->firings[a], r->ns[a]);
+  }
+  fprintf(out, "]}\n");
+}
+
+int main(int argc, char** argv)
+{
+  size_t iterations = 1000000, depth = 0, e;
+  const char* input_file = NULL;
+  const char* format = "csv";
+  const char* result_file = NULL;
+  sdf_schedule_kind kind = SDF_SCHEDULE_SINGLE_APPEARANCE;
+  int i;
+
+  for(i = 1; i + 1 < argc; i += 2) {
+    if(strcmp(argv[i], "-n") == 0) {
+      iterations = strtoul(argv[i + 1], NULL, 0);
+    } else if(strcmp(argv[i], "-i") == 0) {
+      input_file = argv[i + 1];
+    } else if(strcmp(argv[i], "-s") == 0) {
+      kind = strcmp(argv[i + 1], "min") == 0 ? SDF_SCHEDULE_MIN_BUFFER : SDF_SCHEDULE_SINGLE_APPEARANCE;
+    } else if(strcmp(argv[i], "-t") == 0) {
+      depth = strtoul(argv[i + 1], NULL, 0);
+    } else if(strcmp(argv[i], "-f") == 0) {
+      format = argv[i + 1];
+    } else if(strcmp(argv[i], "-o") == 0) {
+      result_file = argv[i + 1];
+    } else {
+      break;
+    }
+  }
+  if(i < argc || iterations == 0) {
+    printf("Usage: %s [-n iterations] [-i tokens.txt] [-s sas|min] [-t depth] [-f csv|json] [-o results]\n", argv[0]);
+    return 1;
+  }
+
+  sdf_graph g;
+  makeGraph(&g);
+  if(sdf_graph_schedule(&g, kind) != SDF_OK) {
+    printf("Graph is inconsistent or deadlocks\n");
+    return 1;
+  }
+  load_inputs(&g, input_file);
+
+  bench_result r;
+  memset(&r, 0, sizeof(r));
+  r.mode = depth ? "threaded" : "sequential";
+  r.schedule = kind == SDF_SCHEDULE_MIN_BUFFER ? "min" : "sas";
+  r.iterations = iterations;
+  for(e = 0; e < g.n_edges; e++) {
+    r.tokens_per_iteration += sdf_graph_tokens(&g, (int) e);
+  }
+
+  if(depth) {
+    bench_threaded(&g, iterations, depth, &r);
+  } else {
+    bench_sequential(&g, iterations, &r);
+  }
+
+  FILE* out = stdout;
+  bool header = true;
+  if(result_file) {
+    FILE* probe = fopen(result_file, "r");
+    if(probe) {
+      header = (fgetc(probe) == EOF);
+      fclose(probe);
+    }
+    out = fopen(result_file, "a");
+    if(!out) {
+      printf("cannot open the file: %s\n", result_file);
+      return 1;
+    }
+  }
+
+  if(strcmp(format, "json") == 0) {
+    write_json(out, &g, &r);
+  } else {
+    write_csv(out, &g, &r, header);
+  }
+
+  if(out != stdout) {
+    fclose(out);
+  }
+  for(e = 0; e < g.n_edges; e++) {
+    free(inputs[e]);
+  }
+  sdf_graph_free(&g);
+  return 0;
+}
@@ -0,0 +1,157 @@
+#ifndef SDF_BLOCK_H_
+#define SDF_BLOCK_H_
+
+/*
+ * Block tokens: a whole frame moves through a channel as one token.
+ *
+ * The channel carries sdf_block pointers (element size sizeof(sdf_block*)),
+ * so an actor with rate 1 receives the frame by reference instead of
+ * width * height pixel tokens, and nothing but the pointer is copied.
+ *
+ * Frames come from a fixed pool allocated once. The actor producing a
+ * frame takes a block from the pool, the actor consuming it for the last
+ * time gives it back. Taking a block from an empty pool waits, so in the
+ * pipelined executor the pool size bounds the frames in flight.
+ *
+ * Build with -pthread.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <assert.h>
+#include <pthread.h>
+
+struct sdf_block_pool_t;
+
+/// Frame descriptor
+typedef struct {
+	void* data;    // width * height elements
+	size_t width;  // elements per row
+	size_t height; // rows
+	size_t elem;   // bytes per element
+	size_t seq;    // frame number, free for the user
+	struct sdf_block_pool_t* pool;
+} sdf_block;
+
+typedef struct sdf_block_pool_t {
+	sdf_block* blocks;
+	sdf_block** free_list;
+	size_t n;
+	size_t n_free;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} sdf_block_pool;
+
+/// Allocate n frames of width * height elements of elem_size bytes
+/// Requires: n > 0
+void sdf_block_pool_init(sdf_block_pool* pool, size_t n, size_t width, size_t height, size_t elem_size);
+
+/// Free the pool and its frames
+/// Requires: every block has been released
+void sdf_block_pool_free(sdf_block_pool* pool);
+
+/// Take a frame from the pool, waiting until one is released if needed
+sdf_block* sdf_block_get(sdf_block_pool* pool);
+
+/// Take a frame from the pool
+/// Returns NULL if every frame is in use
+sdf_block* sdf_block_try_get(sdf_block_pool* pool);
+
+/// Give a frame back to its pool
+void sdf_block_release(sdf_block* b);
+
+#pragma mark - APIs -
+
+void sdf_block_pool_init(sdf_block_pool* pool, size_t n, size_t width, size_t height, size_t elem_size)
+{
+	size_t i;
+
+	assert(pool && n && elem_size);
+
+	pool->blocks = malloc(n * sizeof(sdf_block));
+	pool->free_list = malloc(n * sizeof(sdf_block*));
+	assert(pool->blocks && pool->free_list);
+
+	for(i = 0; i < n; i++)
+	{
+		sdf_block* b = &pool->blocks[i];
+
+		b->data = malloc(width * height * elem_size);
+		assert(b->data);
+		b->width = width;
+		b->height = height;
+		b->elem = elem_size;
+		b->seq = 0;
+		b->pool = pool;
+		pool->free_list[i] = b;
+	}
+
+	pool->n = n;
+	pool->n_free = n;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+}
+
+void sdf_block_pool_free(sdf_block_pool* pool)
+{
+	size_t i;
+
+	assert(pool && pool->n_free == pool->n);
+
+	for(i = 0; i < pool->n; i++)
+	{
+		free(pool->blocks[i].data);
+	}
+
+	free(pool->blocks);
+	free(pool->free_list);
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+sdf_block* sdf_block_get(sdf_block_pool* pool)
+{
+	assert(pool);
+
+	pthread_mutex_lock(&pool->lock);
+	while(pool->n_free == 0)
+	{
+		pthread_cond_wait(&pool->cond, &pool->lock);
+	}
+	sdf_block* b = pool->free_list[--pool->n_free];
+	pthread_mutex_unlock(&pool->lock);
+
+	return b;
+}
+
+sdf_block* sdf_block_try_get(sdf_block_pool* pool)
+{
+	sdf_block* b = NULL;
+
+	assert(pool);
+
+	pthread_mutex_lock(&pool->lock);
+	if(pool->n_free)
+	{
+		b = pool->free_list[--pool->n_free];
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return b;
+}
+
+void sdf_block_release(sdf_block* b)
+{
+	assert(b && b->pool);
+
+	sdf_block_pool* pool = b->pool;
+
+	pthread_mutex_lock(&pool->lock);
+	assert(pool->n_free < pool->n);
+	pool->free_list[pool->n_free++] = b;
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+#endif //SDF_BLOCK_H_
@@ -0,0 +1,448 @@
+#ifndef SDF_PIPELINE_H_
+#define SDF_PIPELINE_H_
+
+/*
+ * Multi-threaded, pipelined executor for SDF graphs.
+ *
+ * Takes a graph described and scheduled with sdf_schedule.h and runs
+ * every actor on its own thread, with every edge mapped to a lock-free
+ * SPSC channel (spsc_channel.h). An actor fires as soon as its inputs
+ * hold enough tokens and its outputs enough room, so the channels give
+ * backpressure and successive iterations overlap: the first actors of
+ * the chain already work on iteration n+1 while the last ones finish
+ * iteration n.
+ *
+ * Each channel holds 'depth' times the tokens the sequential schedule
+ * needs (rounded up to a power of two). Since the sequential sizes admit
+ * a valid schedule, the self-timed execution cannot deadlock; the extra
+ * depth is what lets the iterations overlap.
+ *
+ * Graph inputs and outputs are served by a source/sink callback each,
+ * also on their own thread, called once per iteration with all the
+ * tokens of that iteration (elements of the edge's type).
+ *
+ * For every thread the executor records firings, time spent computing
+ * and time spent blocked on channels; sdf_pipe_report prints the
+ * utilization so the bottleneck actor can be spotted.
+ *
+ * Build with -pthread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "sdf_schedule.h"
+#include "spsc_channel.h"
+
+/// Polls before a blocked thread parks
+#define SDF_PIPE_SPINS 1024
+
+/// Environment callbacks, called once per iteration with n tokens
+typedef void (*sdf_source)(void* ctx, void* out, size_t n);
+typedef void (*sdf_sink)(void* ctx, const void* in, size_t n);
+
+struct sdf_pipeline_t;
+
+/// One thread: an actor, or the source/sink of an environment edge
+typedef struct {
+	struct sdf_pipeline_t* p;
+	int actor;      // actor id, or SDF_EXTERNAL for a source/sink
+	int edge;       // environment edge of a source/sink
+	pthread_t thread;
+	unsigned char* scratch; // wraparound fallback (actor) or iteration buffer (source/sink)
+	uint64_t firings;
+	uint64_t busy_ns;
+	uint64_t blocked_ns;
+} sdf_worker;
+
+typedef struct sdf_pipeline_t {
+	sdf_graph* g;
+	size_t iterations;
+	spsc_handle_t ch[SDF_MAX_EDGES];
+	void* storage[SDF_MAX_EDGES];
+	sdf_source source[SDF_MAX_EDGES];
+	sdf_sink sink[SDF_MAX_EDGES];
+	void* ctx[SDF_MAX_EDGES];
+	sdf_worker workers[SDF_MAX_ACTORS + SDF_MAX_EDGES];
+	size_t n_workers;
+	uint64_t wall_ns;
+} sdf_pipeline;
+
+/// Create the channels of a scheduled graph, with depth times the
+/// sequential buffer sizes, and put the initial tokens in
+/// Requires: sdf_graph_schedule(g, ...) returned SDF_OK, depth >= 1
+void sdf_pipe_init(sdf_pipeline* p, sdf_graph* g, size_t depth);
+
+/// Attach the callback feeding a graph input / draining a graph output
+/// Requires: every environment edge gets one before sdf_pipe_run
+void sdf_pipe_source(sdf_pipeline* p, int edge, sdf_source f, void* ctx);
+void sdf_pipe_sink(sdf_pipeline* p, int edge, sdf_sink f, void* ctx);
+
+/// Run the given number of graph iterations, returns when all threads are done
+void sdf_pipe_run(sdf_pipeline* p, size_t iterations);
+
+/// Print firings and utilization of every thread of the last run
+void sdf_pipe_report(sdf_pipeline* p, FILE* out);
+
+/// Free channels and buffers. The graph is not touched
+void sdf_pipe_free(sdf_pipeline* p);
+
+#pragma mark - Private Functions -
+
+static inline uint64_t sdf_pipe_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static size_t sdf_pipe_pow2(size_t n)
+{
+	size_t r = 1;
+
+	while(r < n)
+	{
+		r <<= 1;
+	}
+
+	return r;
+}
+
+static void sdf_pipe_fire_actor(sdf_worker* w)
+{
+	sdf_pipeline* p = w->p;
+	sdf_graph* g = p->g;
+	void* in[SDF_MAX_PORTS];
+	void* out[SDF_MAX_PORTS];
+	int in_edge[SDF_MAX_PORTS];
+	int out_edge[SDF_MAX_PORTS];
+	bool in_direct[SDF_MAX_PORTS];
+	bool out_direct[SDF_MAX_PORTS];
+	size_t n_in = 0, n_out = 0, e, i;
+	unsigned char* scratch = w->scratch;
+
+	// Ports in declaration order of the edges, as in sdf_graph_build
+	for(e = 0; e < g->n_edges; e++)
+	{
+		if(g->edges[e].dst == w->actor)
+		{
+			in_edge[n_in++] = (int) e;
+		}
+	}
+	for(e = 0; e < g->n_edges; e++)
+	{
+		if(g->edges[e].src == w->actor)
+		{
+			out_edge[n_out++] = (int) e;
+		}
+	}
+
+	uint64_t t0 = sdf_pipe_now();
+
+	// Once available, tokens and room stay available: only this thread takes them
+	for(i = 0; i < n_in; i++)
+	{
+		spsc_wait_readable(p->ch[in_edge[i]], g->edges[in_edge[i]].cons, SDF_PIPE_SPINS);
+	}
+	for(i = 0; i < n_out; i++)
+	{
+		spsc_wait_writable(p->ch[out_edge[i]], g->edges[out_edge[i]].prod, SDF_PIPE_SPINS);
+	}
+
+	uint64_t t1 = sdf_pipe_now();
+
+	for(i = 0; i < n_in; i++)
+	{
+		size_t rate = g->edges[in_edge[i]].cons;
+
+		in[i] = (void*) spsc_read_window(p->ch[in_edge[i]], rate);
+		in_direct[i] = (in[i] != NULL);
+		if(!in_direct[i])
+		{
+			// Wrapped window: copy out, which also releases the slots
+			in[i] = scratch;
+			spsc_try_get_range(p->ch[in_edge[i]], in[i], rate);
+		}
+		scratch += rate * g->edges[in_edge[i]].elem;
+	}
+
+	for(i = 0; i < n_out; i++)
+	{
+		size_t rate = g->edges[out_edge[i]].prod;
+
+		out[i] = spsc_write_window(p->ch[out_edge[i]], rate);
+		out_direct[i] = (out[i] != NULL);
+		if(!out_direct[i])
+		{
+			out[i] = scratch;
+		}
+		scratch += rate * g->edges[out_edge[i]].elem;
+	}
+
+	g->funcs[w->actor](in, out);
+
+	for(i = 0; i < n_out; i++)
+	{
+		size_t rate = g->edges[out_edge[i]].prod;
+
+		if(out_direct[i])
+		{
+			spsc_commit_write(p->ch[out_edge[i]], rate);
+		}
+		else
+		{
+			spsc_try_put_range(p->ch[out_edge[i]], out[i], rate);
+		}
+	}
+
+	for(i = 0; i < n_in; i++)
+	{
+		if(in_direct[i])
+		{
+			spsc_commit_read(p->ch[in_edge[i]], g->edges[in_edge[i]].cons);
+		}
+	}
+
+	uint64_t t2 = sdf_pipe_now();
+
+	w->firings++;
+	w->blocked_ns += t1 - t0;
+	w->busy_ns += t2 - t1;
+}
+
+static void* sdf_pipe_worker(void* arg)
+{
+	sdf_worker* w = arg;
+	sdf_pipeline* p = w->p;
+	sdf_graph* g = p->g;
+	size_t it, t;
+
+	if(w->actor != SDF_EXTERNAL)
+	{
+		size_t n = g->q[w->actor] * p->iterations;
+
+		for(t = 0; t < n; t++)
+		{
+			sdf_pipe_fire_actor(w);
+		}
+		return NULL;
+	}
+
+	sdf_edge* edge = &g->edges[w->edge];
+	size_t n = sdf_graph_tokens(g, w->edge);
+	spsc_handle_t ch = p->ch[w->edge];
+
+	for(it = 0; it < p->iterations; it++)
+	{
+		uint64_t t0 = sdf_pipe_now(), t1, t2;
+
+		if(edge->src == SDF_EXTERNAL)
+		{
+			p->source[w->edge](p->ctx[w->edge], w->scratch, n);
+			t1 = sdf_pipe_now();
+			spsc_put_range_spin(ch, w->scratch, n, SDF_PIPE_SPINS);
+			t2 = sdf_pipe_now();
+			w->busy_ns += t1 - t0;
+			w->blocked_ns += t2 - t1;
+		}
+		else
+		{
+			spsc_get_range_spin(ch, w->scratch, n, SDF_PIPE_SPINS);
+			t1 = sdf_pipe_now();
+			p->sink[w->edge](p->ctx[w->edge], w->scratch, n);
+			t2 = sdf_pipe_now();
+			w->blocked_ns += t1 - t0;
+			w->busy_ns += t2 - t1;
+		}
+		w->firings++;
+	}
+
+	return NULL;
+}
+
+#pragma mark - APIs -
+
+void sdf_pipe_init(sdf_pipeline* p, sdf_graph* g, size_t depth)
+{
+	size_t e, a;
+
+	assert(p && g && g->schedule && depth);
+
+	memset(p, 0, sizeof(sdf_pipeline));
+	p->g = g;
+
+	for(e = 0; e < g->n_edges; e++)
+	{
+		sdf_edge* edge = &g->edges[e];
+
+		// A self-loop must fit the produced tokens before it releases the consumed ones
+		size_t size = edge->size;
+		if(edge->src == edge->dst && size < edge->n_init + edge->prod)
+		{
+			size = edge->n_init + edge->prod;
+		}
+		size = sdf_pipe_pow2(size * depth);
+
+		p->storage[e] = malloc(size * edge->elem);
+		assert(p->storage[e]);
+		p->ch[e] = spsc_init_elem(p->storage[e], size, edge->elem);
+		if(edge->n_init)
+		{
+			spsc_try_put_range(p->ch[e], edge->init, edge->n_init);
+		}
+	}
+
+	for(a = 0; a < g->n_actors; a++)
+	{
+		sdf_worker* w = &p->workers[p->n_workers++];
+		size_t total = 0;
+
+		for(e = 0; e < g->n_edges; e++)
+		{
+			if(g->edges[e].dst == (int) a)
+			{
+				total += g->edges[e].cons * g->edges[e].elem;
+			}
+			if(g->edges[e].src == (int) a)
+			{
+				total += g->edges[e].prod * g->edges[e].elem;
+			}
+		}
+
+		w->p = p;
+		w->actor = (int) a;
+		w->edge = -1;
+		w->scratch = malloc(total ? total : 1);
+		assert(w->scratch);
+	}
+
+	for(e = 0; e < g->n_edges; e++)
+	{
+		if(g->edges[e].src != SDF_EXTERNAL && g->edges[e].dst != SDF_EXTERNAL)
+		{
+			continue;
+		}
+
+		sdf_worker* w = &p->workers[p->n_workers++];
+		w->p = p;
+		w->actor = SDF_EXTERNAL;
+		w->edge = (int) e;
+		w->scratch = malloc(sdf_graph_tokens(g, (int) e) * g->edges[e].elem);
+		assert(w->scratch);
+	}
+}
+
+void sdf_pipe_source(sdf_pipeline* p, int edge, sdf_source f, void* ctx)
+{
+	assert(p && f && edge >= 0 && (size_t) edge < p->g->n_edges);
+	assert(p->g->edges[edge].src == SDF_EXTERNAL);
+
+	p->source[edge] = f;
+	p->ctx[edge] = ctx;
+}
+
+void sdf_pipe_sink(sdf_pipeline* p, int edge, sdf_sink f, void* ctx)
+{
+	assert(p && f && edge >= 0 && (size_t) edge < p->g->n_edges);
+	assert(p->g->edges[edge].dst == SDF_EXTERNAL);
+
+	p->sink[edge] = f;
+	p->ctx[edge] = ctx;
+}
+
+void sdf_pipe_run(sdf_pipeline* p, size_t iterations)
+{
+	size_t i;
+
+	assert(p);
+
+	p->iterations = iterations;
+
+	for(i = 0; i < p->n_workers; i++)
+	{
+		sdf_worker* w = &p->workers[i];
+
+		assert(w->actor != SDF_EXTERNAL || p->source[w->edge] || p->sink[w->edge]);
+		w->firings = 0;
+		w->busy_ns = 0;
+		w->blocked_ns = 0;
+	}
+
+	uint64_t start = sdf_pipe_now();
+
+	for(i = 0; i < p->n_workers; i++)
+	{
+		int r = pthread_create(&p->workers[i].thread, NULL, sdf_pipe_worker, &p->workers[i]);
+		assert(r == 0);
+		(void) r;
+	}
+
+	for(i = 0; i < p->n_workers; i++)
+	{
+		pthread_join(p->workers[i].thread, NULL);
+	}
+
+	p->wall_ns = sdf_pipe_now() - start;
+}
+
+void sdf_pipe_report(sdf_pipeline* p, FILE* out)
+{
+	size_t i;
+
+	assert(p && out);
+
+	double wall = p->wall_ns ? (double) p->wall_ns : 1.0;
+
+	fprintf(out, "%zu iterations in %.3f ms (%.1f iterations/s)\n", p->iterations,
+	        p->wall_ns * 1e-6, p->iterations / (wall * 1e-9));
+	fprintf(out, "%-12s %10s %8s %8s %12s\n", "thread", "firings", "busy%", "blocked%", "ns/firing");
+
+	for(i = 0; i < p->n_workers; i++)
+	{
+		sdf_worker* w = &p->workers[i];
+		char name[32];
+
+		if(w->actor != SDF_EXTERNAL)
+		{
+			snprintf(name, sizeof(name), "%s", p->g->actors[w->actor].name);
+		}
+		else
+		{
+			snprintf(name, sizeof(name), "%s e%d", p->source[w->edge] ? "source" : "sink", w->edge);
+		}
+
+		fprintf(out, "%-12s %10llu %7.1f%% %7.1f%% %12.1f\n", name,
+		        (unsigned long long) w->firings,
+		        100.0 * w->busy_ns / wall,
+		        100.0 * w->blocked_ns / wall,
+		        w->firings ? (double) w->busy_ns / w->firings : 0.0);
+	}
+}
+
+void sdf_pipe_free(sdf_pipeline* p)
+{
+	size_t i;
+
+	assert(p);
+
+	for(i = 0; i < p->g->n_edges; i++)
+	{
+		spsc_free(p->ch[i]);
+		free(p->storage[i]);
+	}
+
+	for(i = 0; i < p->n_workers; i++)
+	{
+		free(p->workers[i].scratch);
+	}
+
+	p->n_workers = 0;
+}
+
+#endif //SDF_PIPELINE_H_
@@ -0,0 +1,726 @@
+#ifndef SDF_SCHEDULE_H_
+#define SDF_SCHEDULE_H_
+
+/*
+ * Static scheduler for SDF graphs built from sdf_actor.h actors.
+ *
+ * A graph is described by its actors, the edges between them (with
+ * production/consumption rates and initial tokens, as delaySDF does in
+ * the ForSyDe models) and the edges from/to the environment. From this
+ * description sdf_graph_schedule
+ *
+ * - computes the repetition vector q from the balance equations
+ *   q[src] * prod = q[dst] * cons, and rejects inconsistent graphs,
+ * - builds a periodic admissible sequential schedule (PASS) by symbolic
+ *   execution of one iteration, which also proves deadlock freedom,
+ * - records the largest number of tokens each edge holds during that
+ *   iteration, which is the size its channel needs.
+ *
+ * sdf_graph_build then allocates every channel with exactly that size,
+ * puts the initial tokens in, and connects the actor ports. Ports are
+ * numbered in the order the edges are declared. Edges carry int tokens
+ * unless declared with an element size (sdf_graph_typed_edge and co).
+ *
+ * Usage:
+ *   sdf_graph g;
+ *   sdf_graph_init(&g);
+ *   int a = sdf_graph_actor(&g, "a", f_a);
+ *   int b = sdf_graph_actor(&g, "b", f_b);
+ *   int s_in  = sdf_graph_input(&g, a, 2);
+ *   int s_1   = sdf_graph_edge(&g, a, 1, b, 2, NULL, 0);
+ *   int s_out = sdf_graph_output(&g, b, 1);
+ *   sdf_graph_schedule(&g, SDF_SCHEDULE_MIN_BUFFER);
+ *   sdf_graph_build(&g);
+ *   while(1) { fill s_in; sdf_graph_iterate(&g); drain s_out; }
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include "sdf_actor.h"
+
+#define SDF_MAX_ACTORS 16
+#define SDF_MAX_EDGES 32
+
+/// Actor id standing for the environment on graph inputs/outputs
+#define SDF_EXTERNAL (-1)
+
+/// Result codes of sdf_graph_schedule
+#define SDF_OK 0
+#define SDF_ERR_INCONSISTENT (-1) // balance equations have no solution
+#define SDF_ERR_DEADLOCK (-2)     // not enough initial tokens on a cycle
+#define SDF_ERR_NO_SAS (-3)       // no flat single-appearance schedule
+
+typedef enum {
+	SDF_SCHEDULE_MIN_BUFFER,       // greedy order keeping buffers small
+	SDF_SCHEDULE_SINGLE_APPEARANCE // each actor appears once, fired q times in a row
+} sdf_schedule_kind;
+
+/// An edge of the graph, becomes one channel
+typedef struct {
+	int src;        // producing actor or SDF_EXTERNAL
+	int dst;        // consuming actor or SDF_EXTERNAL
+	size_t prod;    // tokens produced per firing of src
+	size_t cons;    // tokens consumed per firing of dst
+	size_t elem;    // bytes per token
+	void* init;     // initial tokens (copied), oldest first
+	size_t n_init;
+	size_t size;    // channel size computed by sdf_graph_schedule
+	void* storage;
+	channel ch;
+} sdf_edge;
+
+/// One entry of the schedule: fire actor count times in a row
+typedef struct {
+	int actor;
+	size_t count;
+} sdf_firing;
+
+typedef struct {
+	size_t n_actors;
+	size_t n_edges;
+	sdf_actor actors[SDF_MAX_ACTORS];
+	sdf_func funcs[SDF_MAX_ACTORS];
+	sdf_edge edges[SDF_MAX_EDGES];
+	size_t q[SDF_MAX_ACTORS];  // repetition vector
+	sdf_firing* schedule;      // run-length encoded firing sequence
+	size_t n_firings;
+	bool built;
+} sdf_graph;
+
+/// Initialise an empty graph
+void sdf_graph_init(sdf_graph* g);
+
+/// Add an actor, returns its id
+int sdf_graph_actor(sdf_graph* g, const char* name, sdf_func f);
+
+/// Give an actor a batch form of its function, used for the runs of
+/// consecutive firings in the schedule (see sdf_fire_n)
+void sdf_graph_batch(sdf_graph* g, int actor, sdf_batch_func fb);
+
+/// Add an edge from src to dst with n_init initial tokens, returns its id
+/// Requires: prod > 0 unless src is SDF_EXTERNAL, cons > 0 unless dst is SDF_EXTERNAL
+int sdf_graph_edge(sdf_graph* g, int src, size_t prod, int dst, size_t cons,
+                   const token* init, size_t n_init);
+
+/// Add an edge from the environment to dst / from src to the environment
+int sdf_graph_input(sdf_graph* g, int dst, size_t cons);
+int sdf_graph_output(sdf_graph* g, int src, size_t prod);
+
+/// Same as above for edges whose tokens are elem_size bytes each instead of
+/// token, init points to n_init such elements
+int sdf_graph_typed_edge(sdf_graph* g, int src, size_t prod, int dst, size_t cons,
+                         size_t elem_size, const void* init, size_t n_init);
+int sdf_graph_typed_input(sdf_graph* g, int dst, size_t cons, size_t elem_size);
+int sdf_graph_typed_output(sdf_graph* g, int src, size_t prod, size_t elem_size);
+
+/// Compute the repetition vector, the schedule and the channel sizes
+/// Returns SDF_OK or one of the SDF_ERR_* codes, in which case the graph
+/// keeps the schedule and channel sizes it had
+int sdf_graph_schedule(sdf_graph* g, sdf_schedule_kind kind);
+
+/// Allocate the channels, put the initial tokens and connect the actors
+/// Requires: sdf_graph_schedule returned SDF_OK
+void sdf_graph_build(sdf_graph* g);
+
+/// Run one iteration of the schedule
+/// Requires: the graph is built, inputs hold sdf_graph_tokens tokens,
+///           outputs have room for sdf_graph_tokens tokens
+/// Returns 0 on success, -1 if an actor could not fire
+int sdf_graph_iterate(sdf_graph* g);
+
+/// Channel of an edge, valid once the graph is built
+channel sdf_graph_channel(sdf_graph* g, int edge);
+
+/// Tokens that cross an edge during one iteration
+size_t sdf_graph_tokens(sdf_graph* g, int edge);
+
+/// Print repetition vector, schedule and channel sizes
+void sdf_graph_print(sdf_graph* g, FILE* out);
+
+/// Free channels, storage and actors
+void sdf_graph_free(sdf_graph* g);
+
+#pragma mark - Private Functions -
+
+static unsigned long sdf_gcd(unsigned long a, unsigned long b)
+{
+	while(b)
+	{
+		unsigned long t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+// Solves the balance equations for the component containing 'start',
+// with q as fractions num/den. Returns false on inconsistency.
+static bool sdf_solve_component(sdf_graph* g, int start, unsigned long* num, unsigned long* den)
+{
+	int stack[SDF_MAX_ACTORS];
+	int top = 0;
+	size_t e;
+
+	num[start] = 1;
+	den[start] = 1;
+	stack[top++] = start;
+
+	while(top)
+	{
+		int a = stack[--top];
+
+		for(e = 0; e < g->n_edges; e++)
+		{
+			sdf_edge* edge = &g->edges[e];
+			int other;
+			unsigned long n, d, k;
+
+			if(edge->src == SDF_EXTERNAL || edge->dst == SDF_EXTERNAL)
+			{
+				continue;
+			}
+
+			// q[dst] = q[src] * prod / cons, and the other way round
+			if(edge->src == a)
+			{
+				other = edge->dst;
+				n = num[a] * edge->prod;
+				d = den[a] * edge->cons;
+			}
+			else if(edge->dst == a)
+			{
+				other = edge->src;
+				n = num[a] * edge->cons;
+				d = den[a] * edge->prod;
+			}
+			else
+			{
+				continue;
+			}
+
+			k = sdf_gcd(n, d);
+			n /= k;
+			d /= k;
+
+			if(num[other] == 0)
+			{
+				num[other] = n;
+				den[other] = d;
+				stack[top++] = other;
+			}
+			else if(num[other] != n || den[other] != d)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Repetition vector into q, which starts out zero
+static int sdf_repetitions(sdf_graph* g, size_t* q)
+{
+	unsigned long num[SDF_MAX_ACTORS] = {0};
+	unsigned long den[SDF_MAX_ACTORS] = {0};
+	size_t a, b;
+
+	for(a = 0; a < g->n_actors; a++)
+	{
+		if(num[a])
+		{
+			continue;
+		}
+
+		if(!sdf_solve_component(g, (int) a, num, den))
+		{
+			return SDF_ERR_INCONSISTENT;
+		}
+
+		// Scale the component to the smallest integer solution
+		unsigned long l = 1, k = 0;
+		for(b = 0; b < g->n_actors; b++)
+		{
+			if(num[b] && !q[b])
+			{
+				l = l / sdf_gcd(l, den[b]) * den[b];
+			}
+		}
+		for(b = 0; b < g->n_actors; b++)
+		{
+			if(num[b] && !q[b])
+			{
+				k = sdf_gcd(k, num[b] * (l / den[b]));
+			}
+		}
+		for(b = 0; b < g->n_actors; b++)
+		{
+			if(num[b] && !q[b])
+			{
+				q[b] = num[b] * (l / den[b]) / k;
+			}
+		}
+	}
+
+	return SDF_OK;
+}
+
+// Can actor a fire 'times' times in a row with the given token counts?
+// Environment inputs always hold enough tokens.
+static bool sdf_sim_can_fire(sdf_graph* g, const size_t* tokens, int a, size_t times)
+{
+	size_t sim[SDF_MAX_EDGES];
+	size_t e, t;
+
+	memcpy(sim, tokens, g->n_edges * sizeof(size_t));
+
+	for(t = 0; t < times; t++)
+	{
+		for(e = 0; e < g->n_edges; e++)
+		{
+			if(g->edges[e].dst == a && g->edges[e].src != SDF_EXTERNAL)
+			{
+				if(sim[e] < g->edges[e].cons)
+				{
+					return false;
+				}
+				sim[e] -= g->edges[e].cons;
+			}
+		}
+		for(e = 0; e < g->n_edges; e++)
+		{
+			if(g->edges[e].src == a)
+			{
+				sim[e] += g->edges[e].prod;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void sdf_sim_fire(sdf_graph* g, size_t* tokens, size_t* peak, int a)
+{
+	size_t e;
+
+	// Consumed tokens leave the channel before the produced ones arrive
+	for(e = 0; e < g->n_edges; e++)
+	{
+		if(g->edges[e].dst == a && g->edges[e].src != SDF_EXTERNAL)
+		{
+			tokens[e] -= g->edges[e].cons;
+		}
+	}
+	for(e = 0; e < g->n_edges; e++)
+	{
+		if(g->edges[e].src == a)
+		{
+			tokens[e] += g->edges[e].prod;
+			if(tokens[e] > peak[e])
+			{
+				peak[e] = tokens[e];
+			}
+		}
+	}
+}
+
+// Net number of tokens a firing of a adds to the internal channels
+static long sdf_growth(sdf_graph* g, int a)
+{
+	long growth = 0;
+	size_t e;
+
+	for(e = 0; e < g->n_edges; e++)
+	{
+		if(g->edges[e].src == SDF_EXTERNAL || g->edges[e].dst == SDF_EXTERNAL)
+		{
+			continue;
+		}
+		if(g->edges[e].src == a)
+		{
+			growth += (long) g->edges[e].prod;
+		}
+		if(g->edges[e].dst == a)
+		{
+			growth -= (long) g->edges[e].cons;
+		}
+	}
+
+	return growth;
+}
+
+static void sdf_append_firing(sdf_firing* schedule, size_t* n_firings, int a, size_t count)
+{
+	if(*n_firings && schedule[*n_firings - 1].actor == a)
+	{
+		schedule[*n_firings - 1].count += count;
+		return;
+	}
+
+	schedule[*n_firings].actor = a;
+	schedule[*n_firings].count = count;
+	(*n_firings)++;
+}
+
+// Symbolic execution of one iteration with repetition vector q, into
+// schedule (room for the sum of q firings) and the peak token count of
+// every edge. Leaves g unchanged.
+static int sdf_simulate(sdf_graph* g, sdf_schedule_kind kind, const size_t* q,
+                        sdf_firing* schedule, size_t* n_firings, size_t* peak)
+{
+	size_t tokens[SDF_MAX_EDGES];
+	size_t remaining[SDF_MAX_ACTORS];
+	size_t a, e, total = 0;
+
+	for(a = 0; a < g->n_actors; a++)
+	{
+		remaining[a] = q[a];
+		total += q[a];
+	}
+
+	for(e = 0; e < g->n_edges; e++)
+	{
+		tokens[e] = g->edges[e].n_init;
+		peak[e] = g->edges[e].n_init;
+	}
+
+	*n_firings = 0;
+
+	while(total)
+	{
+		int best = -1;
+		long best_growth = 0;
+
+		for(a = 0; a < g->n_actors; a++)
+		{
+			if(!remaining[a])
+			{
+				continue;
+			}
+
+			if(kind == SDF_SCHEDULE_SINGLE_APPEARANCE)
+			{
+				if(sdf_sim_can_fire(g, tokens, (int) a, remaining[a]))
+				{
+					best = (int) a;
+					break;
+				}
+			}
+			else if(sdf_sim_can_fire(g, tokens, (int) a, 1))
+			{
+				long growth = sdf_growth(g, (int) a);
+				if(best < 0 || growth < best_growth)
+				{
+					best = (int) a;
+					best_growth = growth;
+				}
+			}
+		}
+
+		if(best < 0)
+		{
+			return SDF_ERR_DEADLOCK;
+		}
+
+		size_t count = (kind == SDF_SCHEDULE_SINGLE_APPEARANCE) ? remaining[best] : 1;
+		size_t t;
+		for(t = 0; t < count; t++)
+		{
+			sdf_sim_fire(g, tokens, peak, best);
+		}
+		sdf_append_firing(schedule, n_firings, best, count);
+		remaining[best] -= count;
+		total -= count;
+	}
+
+	return SDF_OK;
+}
+
+#pragma mark - APIs -
+
+void sdf_graph_init(sdf_graph* g)
+{
+	assert(g);
+
+	memset(g, 0, sizeof(sdf_graph));
+}
+
+int sdf_graph_actor(sdf_graph* g, const char* name, sdf_func f)
+{
+	assert(g && f && g->n_actors < SDF_MAX_ACTORS && !g->built);
+
+	sdf_actor_init(&g->actors[g->n_actors], name, f);
+	g->funcs[g->n_actors] = f;
+
+	return (int) g->n_actors++;
+}
+
+void sdf_graph_batch(sdf_graph* g, int actor, sdf_batch_func fb)
+{
+	assert(g && actor >= 0 && (size_t) actor < g->n_actors);
+
+	sdf_actor_batch(&g->actors[actor], fb);
+}
+
+int sdf_graph_edge(sdf_graph* g, int src, size_t prod, int dst, size_t cons,
+                   const token* init, size_t n_init)
+{
+	return sdf_graph_typed_edge(g, src, prod, dst, cons, sizeof(token), init, n_init);
+}
+
+int sdf_graph_typed_edge(sdf_graph* g, int src, size_t prod, int dst, size_t cons,
+                         size_t elem_size, const void* init, size_t n_init)
+{
+	assert(g && g->n_edges < SDF_MAX_EDGES && !g->built && elem_size);
+	assert(src == SDF_EXTERNAL || (src >= 0 && (size_t) src < g->n_actors && prod));
+	assert(dst == SDF_EXTERNAL || (dst >= 0 && (size_t) dst < g->n_actors && cons));
+	assert(src != SDF_EXTERNAL || dst != SDF_EXTERNAL);
+
+	sdf_edge* edge = &g->edges[g->n_edges];
+	edge->src = src;
+	edge->dst = dst;
+	edge->prod = prod;
+	edge->cons = cons;
+	edge->elem = elem_size;
+	edge->n_init = n_init;
+	edge->init = NULL;
+
+	if(n_init)
+	{
+		assert(init);
+		edge->init = malloc(n_init * elem_size);
+		assert(edge->init);
+		memcpy(edge->init, init, n_init * elem_size);
+	}
+
+	return (int) g->n_edges++;
+}
+
+int sdf_graph_input(sdf_graph* g, int dst, size_t cons)
+{
+	return sdf_graph_edge(g, SDF_EXTERNAL, 0, dst, cons, NULL, 0);
+}
+
+int sdf_graph_output(sdf_graph* g, int src, size_t prod)
+{
+	return sdf_graph_edge(g, src, prod, SDF_EXTERNAL, 0, NULL, 0);
+}
+
+int sdf_graph_typed_input(sdf_graph* g, int dst, size_t cons, size_t elem_size)
+{
+	return sdf_graph_typed_edge(g, SDF_EXTERNAL, 0, dst, cons, elem_size, NULL, 0);
+}
+
+int sdf_graph_typed_output(sdf_graph* g, int src, size_t prod, size_t elem_size)
+{
+	return sdf_graph_typed_edge(g, src, prod, SDF_EXTERNAL, 0, elem_size, NULL, 0);
+}
+
+int sdf_graph_schedule(sdf_graph* g, sdf_schedule_kind kind)
+{
+	size_t q[SDF_MAX_ACTORS] = {0};
+	size_t peak[SDF_MAX_EDGES];
+	sdf_firing* schedule;
+	size_t n_firings, a, e, total = 0;
+	int r;
+
+	assert(g && !g->built);
+
+	// Everything is worked out on the side, g only changes on success
+	r = sdf_repetitions(g, q);
+	if(r != SDF_OK)
+	{
+		return r;
+	}
+
+	for(a = 0; a < g->n_actors; a++)
+	{
+		total += q[a];
+	}
+
+	schedule = malloc(total * sizeof(sdf_firing));
+	assert(schedule);
+
+	r = sdf_simulate(g, kind, q, schedule, &n_firings, peak);
+	if(r == SDF_ERR_DEADLOCK && kind == SDF_SCHEDULE_SINGLE_APPEARANCE &&
+	   sdf_simulate(g, SDF_SCHEDULE_MIN_BUFFER, q, schedule, &n_firings, peak) == SDF_OK)
+	{
+		// Not a real deadlock, the graph only needs interleaving
+		r = SDF_ERR_NO_SAS;
+	}
+	if(r != SDF_OK)
+	{
+		free(schedule);
+		return r;
+	}
+
+	memcpy(g->q, q, sizeof(g->q));
+	free(g->schedule);
+	g->schedule = schedule;
+	g->n_firings = n_firings;
+
+	for(e = 0; e < g->n_edges; e++)
+	{
+		sdf_edge* edge = &g->edges[e];
+
+		if(edge->src == SDF_EXTERNAL)
+		{
+			// The environment provides a whole iteration of input up front
+			edge->size = g->q[edge->dst] * edge->cons;
+		}
+		else
+		{
+			edge->size = peak[e];
+		}
+
+		if(edge->size == 0)
+		{
+			edge->size = 1;
+		}
+	}
+
+	return SDF_OK;
+}
+
+void sdf_graph_build(sdf_graph* g)
+{
+	size_t a, e;
+
+	assert(g && g->schedule && !g->built);
+
+	for(e = 0; e < g->n_edges; e++)
+	{
+		sdf_edge* edge = &g->edges[e];
+
+		edge->storage = malloc(edge->size * edge->elem);
+		assert(edge->storage);
+		edge->ch = circular_buf_init_elem(edge->storage, edge->size, edge->elem);
+		if(edge->n_init)
+		{
+			circular_buf_put_range(edge->ch, edge->init, edge->n_init);
+		}
+	}
+
+	// Ports in declaration order of the edges
+	for(a = 0; a < g->n_actors; a++)
+	{
+		for(e = 0; e < g->n_edges; e++)
+		{
+			if(g->edges[e].dst == (int) a)
+			{
+				sdf_actor_input(&g->actors[a], g->edges[e].ch, g->edges[e].cons);
+			}
+		}
+		for(e = 0; e < g->n_edges; e++)
+		{
+			if(g->edges[e].src == (int) a)
+			{
+				sdf_actor_output(&g->actors[a], g->edges[e].ch, g->edges[e].prod);
+			}
+		}
+	}
+
+	g->built = true;
+}
+
+int sdf_graph_iterate(sdf_graph* g)
+{
+	size_t i;
+
+	assert(g && g->built);
+
+	// Runs of the same actor go through its batch form, if it has one
+	for(i = 0; i < g->n_firings; i++)
+	{
+		if(sdf_fire_n(&g->actors[g->schedule[i].actor], g->schedule[i].count) != 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+channel sdf_graph_channel(sdf_graph* g, int edge)
+{
+	assert(g && g->built && edge >= 0 && (size_t) edge < g->n_edges);
+
+	return g->edges[edge].ch;
+}
+
+size_t sdf_graph_tokens(sdf_graph* g, int edge)
+{
+	assert(g && edge >= 0 && (size_t) edge < g->n_edges);
+
+	sdf_edge* e = &g->edges[edge];
+
+	return e->src != SDF_EXTERNAL ? g->q[e->src] * e->prod : g->q[e->dst] * e->cons;
+}
+
+void sdf_graph_print(sdf_graph* g, FILE* out)
+{
+	size_t a, e, i;
+
+	assert(g && out);
+
+	fprintf(out, "Repetition vector:");
+	for(a = 0; a < g->n_actors; a++)
+	{
+		fprintf(out, " %s=%zu", g->actors[a].name, g->q[a]);
+	}
+
+	fprintf(out, "\nSchedule: ");
+	for(i = 0; i < g->n_firings; i++)
+	{
+		if(g->schedule[i].count > 1)
+		{
+			fprintf(out, "%s%zu%s", i ? "," : "", g->schedule[i].count, g->actors[g->schedule[i].actor].name);
+		}
+		else
+		{
+			fprintf(out, "%s%s", i ? "," : "", g->actors[g->schedule[i].actor].name);
+		}
+	}
+
+	fprintf(out, "\nChannel sizes:");
+	for(e = 0; e < g->n_edges; e++)
+	{
+		fprintf(out, " e%zu=%zu", e, g->edges[e].size);
+		if(g->edges[e].elem != sizeof(token))
+		{
+			fprintf(out, "x%zuB", g->edges[e].elem);
+		}
+	}
+	fprintf(out, "\n");
+}
+
+void sdf_graph_free(sdf_graph* g)
+{
+	size_t a, e;
+
+	assert(g);
+
+	for(a = 0; a < g->n_actors; a++)
+	{
+		sdf_actor_free(&g->actors[a]);
+	}
+
+	for(e = 0; e < g->n_edges; e++)
+	{
+		if(g->built)
+		{
+			circular_buf_free(g->edges[e].ch);
+			free(g->edges[e].storage);
+		}
+		free(g->edges[e].init);
+	}
+
+	free(g->schedule);
+	sdf_graph_init(g);
+}
+
+#endif //SDF_SCHEDULE_H_
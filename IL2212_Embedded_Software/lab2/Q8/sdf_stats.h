@@ -0,0 +1,156 @@
+#ifndef SDF_STATS_H_
+#define SDF_STATS_H_
+
+/*
+ * Dump of the instrumentation of an SDF graph built with sdf_schedule.h.
+ *
+ * Build with -DSDF_STATS to have circular_buffer.h count per channel the
+ * peak occupancy, the elements moved, and the overwrites, underflows and
+ * rejected writes, and to have sdf_actor.h time every firing with the
+ * cycle counter. Without SDF_STATS none of that code is compiled in and
+ * the dump functions only print the channel sizes.
+ *
+ * The peak occupancy against the allocated size tells how much on-chip
+ * memory a channel really needs. The share of cycles per actor shows the
+ * bottleneck.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "sdf_schedule.h"
+
+/// Print one table for the channels and one for the actors
+void sdf_stats_print(sdf_graph* g, FILE* out);
+
+/// Same data as one JSON object
+void sdf_stats_json(sdf_graph* g, FILE* out);
+
+#pragma mark - Private Functions -
+
+static const char* sdf_stats_name(sdf_graph* g, int actor)
+{
+	return actor == SDF_EXTERNAL ? "env" : g->actors[actor].name;
+}
+
+#pragma mark - APIs -
+
+void sdf_stats_print(sdf_graph* g, FILE* out)
+{
+	size_t e, a;
+
+	assert(g && g->built && out);
+
+	fprintf(out, "%-4s %-16s %8s %5s", "edge", "src->dst", "size", "elem");
+#ifdef SDF_STATS
+	fprintf(out, " %8s %12s %12s %10s %10s %10s", "peak", "put", "got", "overwrite", "underflow", "reject");
+#endif
+	fprintf(out, "\n");
+
+	for(e = 0; e < g->n_edges; e++)
+	{
+		sdf_edge* edge = &g->edges[e];
+		char name[40];
+
+		snprintf(name, sizeof(name), "%s->%s", sdf_stats_name(g, edge->src), sdf_stats_name(g, edge->dst));
+		fprintf(out, "e%-3zu %-16s %8zu %5zu", e, name, edge->size, edge->elem);
+#ifdef SDF_STATS
+		cbuf_stats_t cs;
+		circular_buf_stats(edge->ch, &cs);
+		fprintf(out, " %8zu %12llu %12llu %10llu %10llu %10llu", cs.peak,
+		        (unsigned long long) cs.put, (unsigned long long) cs.got,
+		        (unsigned long long) cs.overwrites, (unsigned long long) cs.underflows,
+		        (unsigned long long) cs.rejects);
+#endif
+		fprintf(out, "\n");
+	}
+
+#ifdef SDF_STATS
+	uint64_t total = 0;
+	for(a = 0; a < g->n_actors; a++)
+	{
+		total += g->actors[a].stats.cycles;
+	}
+
+	fprintf(out, "\n%-12s %10s %12s %10s %10s %7s\n", "actor", "firings", "cycles/fire", "min", "max", "share");
+	for(a = 0; a < g->n_actors; a++)
+	{
+		sdf_actor_stats_t* as = &g->actors[a].stats;
+
+		fprintf(out, "%-12s %10llu %12.1f %10llu %10llu %6.1f%%\n", g->actors[a].name,
+		        (unsigned long long) as->firings,
+		        as->firings ? (double) as->cycles / as->firings : 0.0,
+		        (unsigned long long) as->cycles_min, (unsigned long long) as->cycles_max,
+		        total ? 100.0 * as->cycles / total : 0.0);
+	}
+
+	fprintf(out, "\nfiring time histogram (cycles: firings)\n");
+	for(a = 0; a < g->n_actors; a++)
+	{
+		sdf_actor_stats_t* as = &g->actors[a].stats;
+		size_t b;
+
+		fprintf(out, "%-12s", g->actors[a].name);
+		for(b = 0; b < SDF_HIST_BUCKETS; b++)
+		{
+			if(as->hist[b])
+			{
+				fprintf(out, " %llu+: %llu", 1ull << b, (unsigned long long) as->hist[b]);
+			}
+		}
+		fprintf(out, "\n");
+	}
+#else
+	(void) a;
+#endif
+}
+
+void sdf_stats_json(sdf_graph* g, FILE* out)
+{
+	size_t e, a;
+
+	assert(g && g->built && out);
+
+	fprintf(out, "{\"channels\": [");
+	for(e = 0; e < g->n_edges; e++)
+	{
+		sdf_edge* edge = &g->edges[e];
+
+		fprintf(out, "%s\n  {\"edge\": %zu, \"src\": \"%s\", \"dst\": \"%s\", \"size\": %zu, \"elem\": %zu",
+		        e ? "," : "", e, sdf_stats_name(g, edge->src), sdf_stats_name(g, edge->dst),
+		        edge->size, edge->elem);
+#ifdef SDF_STATS
+		cbuf_stats_t cs;
+		circular_buf_stats(edge->ch, &cs);
+		fprintf(out, ", \"peak\": %zu, \"put\": %llu, \"got\": %llu, \"overwrites\": %llu, \"underflows\": %llu, \"rejects\": %llu",
+		        cs.peak, (unsigned long long) cs.put, (unsigned long long) cs.got,
+		        (unsigned long long) cs.overwrites, (unsigned long long) cs.underflows,
+		        (unsigned long long) cs.rejects);
+#endif
+		fprintf(out, "}");
+	}
+
+	fprintf(out, "],\n \"actors\": [");
+	for(a = 0; a < g->n_actors; a++)
+	{
+		fprintf(out, "%s\n  {\"name\": \"%s\", \"repetitions\": %zu", a ? "," : "", g->actors[a].name, g->q[a]);
+#ifdef SDF_STATS
+		sdf_actor_stats_t* as = &g->actors[a].stats;
+		size_t b;
+
+		fprintf(out, ", \"firings\": %llu, \"cycles\": %llu, \"min\": %llu, \"max\": %llu, \"hist\": [",
+		        (unsigned long long) as->firings, (unsigned long long) as->cycles,
+		        (unsigned long long) as->cycles_min, (unsigned long long) as->cycles_max);
+		for(b = 0; b < SDF_HIST_BUCKETS; b++)
+		{
+			fprintf(out, "%s%llu", b ? ", " : "", (unsigned long long) as->hist[b]);
+		}
+		fprintf(out, "]");
+#endif
+		fprintf(out, "}");
+	}
+	fprintf(out, "]}\n");
+}
+
+#endif //SDF_STATS_H_
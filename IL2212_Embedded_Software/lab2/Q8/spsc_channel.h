@@ -0,0 +1,413 @@
+#ifndef SPSC_CHANNEL_H_
+#define SPSC_CHANNEL_H_
+
+/*
+ * Lock-free single-producer/single-consumer channel.
+ *
+ * Unlike circular_buffer.h this channel may be shared by two threads,
+ * one only writing and one only reading, so a producer actor and a
+ * consumer actor can run on different cores.
+ *
+ * - head (written by the producer) and tail (written by the consumer)
+ *   live on separate cache lines, each side also keeps a cached copy of
+ *   the other side's index so it only touches the remote line when the
+ *   cached value says the channel is full/empty.
+ * - Tokens are published with release stores and observed with acquire
+ *   loads of the indices.
+ * - Indices are committed once per range (or per window), not per token.
+ *
+ * Three flavours of put/get are offered: non-blocking (try), blocking
+ * (parks on a condition variable) and spin-then-park.
+ *
+ * Build with -pthread.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "circular_buffer.h" /* defines data type token */
+
+#define SPSC_CACHE_LINE 64
+
+/// Opaque channel structure
+typedef struct spsc_channel_t spsc_channel_t;
+
+/// Handle type, the way users interact with the API
+typedef spsc_channel_t* spsc_handle_t;
+
+/// Pass in a storage buffer and size, returns a channel handle
+/// Requires: buffer is not NULL, size is a power of two
+/// Ensures: channel has been created and is returned in an empty state
+spsc_handle_t spsc_init(token* buffer, size_t size);
+
+/// Typed channel: size elements of elem_size bytes each
+/// Requires: buffer is not NULL, size is a power of two, elem_size > 0
+/// Ensures: channel has been created and is returned in an empty state
+spsc_handle_t spsc_init_elem(void* buffer, size_t size, size_t elem_size);
+
+/// Size in bytes of one element of the channel
+size_t spsc_elem_size(spsc_handle_t ch);
+
+/// Free a channel structure
+/// Requires: ch is valid and no thread uses it anymore
+/// Does not free data buffer; owner is responsible for that
+void spsc_free(spsc_handle_t ch);
+
+/// Check the capacity of the channel
+size_t spsc_capacity(spsc_handle_t ch);
+
+/// Number of tokens stored in the channel, exact only when called by
+/// the producer or the consumer while the other side is idle
+size_t spsc_size(spsc_handle_t ch);
+
+/// Non-blocking put/get of len tokens, all or nothing
+/// Requires: put called by the producer only, get by the consumer only
+/// Returns 0 on success, -1 if there is not enough room / not enough tokens
+int spsc_try_put_range(spsc_handle_t ch, const void* data, size_t len);
+int spsc_try_get_range(spsc_handle_t ch, void* data, size_t len);
+
+/// Blocking put/get of len tokens, parks the calling thread until done
+/// Requires: len <= capacity
+void spsc_put_range(spsc_handle_t ch, const void* data, size_t len);
+void spsc_get_range(spsc_handle_t ch, void* data, size_t len);
+
+/// Spin-then-park put/get: polls up to 'spins' times before parking
+/// Requires: len <= capacity
+void spsc_put_range_spin(spsc_handle_t ch, const void* data, size_t len, unsigned spins);
+void spsc_get_range_spin(spsc_handle_t ch, void* data, size_t len, unsigned spins);
+
+/// Zero-copy producer window: returns a pointer to len contiguous free
+/// slots, or NULL if they are not available right now (full, or the
+/// slots would wrap around). The tokens become visible with spsc_commit_write.
+void* spsc_write_window(spsc_handle_t ch, size_t len);
+void spsc_commit_write(spsc_handle_t ch, size_t len);
+
+/// Zero-copy consumer window: returns a pointer to len contiguous stored
+/// tokens, or NULL if not available. The slots are released with spsc_commit_read.
+const void* spsc_read_window(spsc_handle_t ch, size_t len);
+void spsc_commit_read(spsc_handle_t ch, size_t len);
+
+/// Block (spin-then-park) until len tokens / len free slots are available
+void spsc_wait_readable(spsc_handle_t ch, size_t len, unsigned spins);
+void spsc_wait_writable(spsc_handle_t ch, size_t len, unsigned spins);
+
+// The definition of the channel structure is hidden from the user
+struct spsc_channel_t {
+	// Producer side
+	_Alignas(SPSC_CACHE_LINE) _Atomic size_t head;
+	size_t tail_cache;
+
+	// Consumer side
+	_Alignas(SPSC_CACHE_LINE) _Atomic size_t tail;
+	size_t head_cache;
+
+	// Read-only after init, and the parking lot
+	_Alignas(SPSC_CACHE_LINE) unsigned char * buffer;
+	size_t elem; // bytes per element
+	size_t max;
+	size_t mask;
+	_Atomic int waiters;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+#pragma mark - Private Functions -
+
+static inline void spsc_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+// Free slots as seen by the producer. The consumer's index is only
+// reloaded when the cached one does not leave room for len tokens.
+static inline size_t spsc_free_slots(spsc_handle_t ch, size_t len)
+{
+	size_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+
+	if(ch->max - (head - ch->tail_cache) < len)
+	{
+		ch->tail_cache = atomic_load_explicit(&ch->tail, memory_order_acquire);
+	}
+
+	return ch->max - (head - ch->tail_cache);
+}
+
+// Stored tokens as seen by the consumer. The producer's index is only
+// reloaded when the cached one does not cover len tokens.
+static inline size_t spsc_stored(spsc_handle_t ch, size_t len)
+{
+	size_t tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+
+	if(ch->head_cache - tail < len)
+	{
+		ch->head_cache = atomic_load_explicit(&ch->head, memory_order_acquire);
+	}
+
+	return ch->head_cache - tail;
+}
+
+// Wakes up a parked peer, if any. The fence pairs with the one in
+// spsc_park so that either the waiter sees the new index or we see the waiter.
+static inline void spsc_notify(spsc_handle_t ch)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if(atomic_load_explicit(&ch->waiters, memory_order_relaxed) > 0)
+	{
+		pthread_mutex_lock(&ch->lock);
+		pthread_cond_broadcast(&ch->cond);
+		pthread_mutex_unlock(&ch->lock);
+	}
+}
+
+// Parks until ready(ch, len) holds
+static void spsc_park(spsc_handle_t ch, size_t len, bool (*ready)(spsc_handle_t, size_t))
+{
+	pthread_mutex_lock(&ch->lock);
+	atomic_fetch_add_explicit(&ch->waiters, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	while(!ready(ch, len))
+	{
+		pthread_cond_wait(&ch->cond, &ch->lock);
+	}
+
+	atomic_fetch_sub_explicit(&ch->waiters, 1, memory_order_relaxed);
+	pthread_mutex_unlock(&ch->lock);
+}
+
+static bool spsc_readable(spsc_handle_t ch, size_t len)
+{
+	return spsc_stored(ch, len) >= len;
+}
+
+static bool spsc_writable(spsc_handle_t ch, size_t len)
+{
+	return spsc_free_slots(ch, len) >= len;
+}
+
+#pragma mark - APIs -
+
+spsc_handle_t spsc_init(token* buffer, size_t size)
+{
+	return spsc_init_elem(buffer, size, sizeof(token));
+}
+
+spsc_handle_t spsc_init_elem(void* buffer, size_t size, size_t elem_size)
+{
+	assert(buffer && size && (size & (size - 1)) == 0 && elem_size);
+
+	spsc_handle_t ch = aligned_alloc(SPSC_CACHE_LINE, sizeof(spsc_channel_t));
+	assert(ch);
+
+	atomic_init(&ch->head, 0);
+	atomic_init(&ch->tail, 0);
+	atomic_init(&ch->waiters, 0);
+	ch->tail_cache = 0;
+	ch->head_cache = 0;
+	ch->buffer = buffer;
+	ch->elem = elem_size;
+	ch->max = size;
+	ch->mask = size - 1;
+	pthread_mutex_init(&ch->lock, NULL);
+	pthread_cond_init(&ch->cond, NULL);
+
+	return ch;
+}
+
+void spsc_free(spsc_handle_t ch)
+{
+	assert(ch);
+
+	pthread_cond_destroy(&ch->cond);
+	pthread_mutex_destroy(&ch->lock);
+	free(ch);
+}
+
+size_t spsc_elem_size(spsc_handle_t ch)
+{
+	assert(ch);
+
+	return ch->elem;
+}
+
+size_t spsc_capacity(spsc_handle_t ch)
+{
+	assert(ch);
+
+	return ch->max;
+}
+
+size_t spsc_size(spsc_handle_t ch)
+{
+	assert(ch);
+
+	return atomic_load_explicit(&ch->head, memory_order_acquire)
+		- atomic_load_explicit(&ch->tail, memory_order_acquire);
+}
+
+void* spsc_write_window(spsc_handle_t ch, size_t len)
+{
+	assert(ch);
+
+	size_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+	size_t idx = head & ch->mask;
+
+	if(spsc_free_slots(ch, len) < len || idx + len > ch->max)
+	{
+		return NULL;
+	}
+
+	return ch->buffer + idx * ch->elem;
+}
+
+void spsc_commit_write(spsc_handle_t ch, size_t len)
+{
+	assert(ch);
+
+	size_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+	atomic_store_explicit(&ch->head, head + len, memory_order_release);
+	spsc_notify(ch);
+}
+
+const void* spsc_read_window(spsc_handle_t ch, size_t len)
+{
+	assert(ch);
+
+	size_t tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+	size_t idx = tail & ch->mask;
+
+	if(spsc_stored(ch, len) < len || idx + len > ch->max)
+	{
+		return NULL;
+	}
+
+	return ch->buffer + idx * ch->elem;
+}
+
+void spsc_commit_read(spsc_handle_t ch, size_t len)
+{
+	assert(ch);
+
+	size_t tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+	atomic_store_explicit(&ch->tail, tail + len, memory_order_release);
+	spsc_notify(ch);
+}
+
+int spsc_try_put_range(spsc_handle_t ch, const void* data, size_t len)
+{
+	assert(ch && data);
+
+	if(spsc_free_slots(ch, len) < len)
+	{
+		return -1;
+	}
+
+	size_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+	size_t idx = head & ch->mask;
+	size_t first = ch->max - idx;
+	if(first > len)
+	{
+		first = len;
+	}
+
+	memcpy(ch->buffer + idx * ch->elem, data, first * ch->elem);
+	memcpy(ch->buffer, (const unsigned char*) data + first * ch->elem, (len - first) * ch->elem);
+
+	spsc_commit_write(ch, len);
+
+	return 0;
+}
+
+int spsc_try_get_range(spsc_handle_t ch, void* data, size_t len)
+{
+	assert(ch && data);
+
+	if(spsc_stored(ch, len) < len)
+	{
+		return -1;
+	}
+
+	size_t tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+	size_t idx = tail & ch->mask;
+	size_t first = ch->max - idx;
+	if(first > len)
+	{
+		first = len;
+	}
+
+	memcpy(data, ch->buffer + idx * ch->elem, first * ch->elem);
+	memcpy((unsigned char*) data + first * ch->elem, ch->buffer, (len - first) * ch->elem);
+
+	spsc_commit_read(ch, len);
+
+	return 0;
+}
+
+void spsc_wait_readable(spsc_handle_t ch, size_t len, unsigned spins)
+{
+	assert(ch && len <= ch->max);
+
+	while(spins--)
+	{
+		if(spsc_readable(ch, len))
+		{
+			return;
+		}
+		spsc_cpu_relax();
+	}
+
+	spsc_park(ch, len, spsc_readable);
+}
+
+void spsc_wait_writable(spsc_handle_t ch, size_t len, unsigned spins)
+{
+	assert(ch && len <= ch->max);
+
+	while(spins--)
+	{
+		if(spsc_writable(ch, len))
+		{
+			return;
+		}
+		spsc_cpu_relax();
+	}
+
+	spsc_park(ch, len, spsc_writable);
+}
+
+void spsc_put_range_spin(spsc_handle_t ch, const void* data, size_t len, unsigned spins)
+{
+	while(spsc_try_put_range(ch, data, len) != 0)
+	{
+		spsc_wait_writable(ch, len, spins);
+	}
+}
+
+void spsc_get_range_spin(spsc_handle_t ch, void* data, size_t len, unsigned spins)
+{
+	while(spsc_try_get_range(ch, data, len) != 0)
+	{
+		spsc_wait_readable(ch, len, spins);
+	}
+}
+
+void spsc_put_range(spsc_handle_t ch, const void* data, size_t len)
+{
+	spsc_put_range_spin(ch, data, len, 0);
+}
+
+void spsc_get_range(spsc_handle_t ch, void* data, size_t len)
+{
+	spsc_get_range_spin(ch, data, len, 0);
+}
+
+#endif //SPSC_CHANNEL_H_
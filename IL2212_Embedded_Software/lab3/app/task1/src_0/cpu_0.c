@@ -19,7 +19,9 @@
 #include "io.h"
 
 #include "images.h"
+#include "gray.h"
 #include "ascii_gray.h"
+#include "ascii.h"
 
 #define DEBUG 1
 
@@ -100,37 +102,23 @@ void *Comm23Msg[1];
 // SW-Timer
 OS_TMR *Task1Tmr;
 
-void asciiSDF(int x, int y, unsigned char* pix, unsigned char* ascii){
+// Text of the frame, rebuilt only when the frame size changes
+ascii_screen_t screen;
+char* screen_mem = NULL;
 
-	//Copy code from lab2
-	//number of ascii values
-	int nlevels = sizeof(asciiChars) / sizeof(char);
-
-	//assign grayscale values to ascii
-	int n = 0;	
-	for(n = 0; n < x*y; n++){
-		int leveln = pix[n] / nlevels;
-		ascii[n] = asciiChars[leveln];
+void asciiSDF(int x, int y, unsigned char* pix){
+	// Table lookup per pixel, the whole frame goes out in one write
+	if(screen.w != x || screen.h != y){
+		free(screen_mem);
+		screen_mem = (char*)malloc(ASCII_SCREEN_BYTES(x, y));
+		ascii_screen_init(&screen, x, y, asciiChars, NR_ASCII_CHARS, ASCII_DIFF, screen_mem);
 	}
+	ascii_screen_show(&screen, pix, x);
 } 
 
-void conversion(unsigned char* rgb, unsigned char* gray){
-
-	*gray = rgb[0] * 0.3125 + rgb[1] * 0.5625 + rgb[2] * 0.125;
-}
-
-
 void graySDF(int x, int y, unsigned char* rgb_pix, unsigned char* gray_pix){
-
-	//Copy code from lab2
-	// split into arrays of 3 [rgb]
-	// apply conversion of each array
-	// re-combine all arrays into single array	
-	// return an array of doubles	
-	int n = 0;
-	for(n = 0; n < x*y; n++){
-		conversion(rgb_pix + 3*n, gray_pix + n);
-	}
+	// (5r + 9g + 2b) >> 4, bit-exact with the model, see gray.h
+	gray_convert(rgb_pix, gray_pix, x*y);
 }
 
 
@@ -202,8 +190,9 @@ void task2_graySDF(){
 		PERF_START_MEASURING (PERFORMANCE_COUNTER_0_BASE);
 		PERF_BEGIN(PERFORMANCE_COUNTER_0_BASE, SECTION_1);
 
-		int h = *img;
-		int w = *(img + 1);
+		// PPM order: width, height, max value
+		int w = *img;
+		int h = *(img + 1);
 		unsigned char* data = (int*)(img + 3);
 		//printf("w,h = %d,%d\n", w, h);
 
@@ -212,8 +201,8 @@ void task2_graySDF(){
 
 		graySDF(w, h, data, gray_pix + 3);
 	
-		gray_pix[0] = h;
-		gray_pix[1] = w;
+		gray_pix[0] = w;
+		gray_pix[1] = h;
 
 
 		PERF_END(PERFORMANCE_COUNTER_0_BASE, SECTION_1);  
@@ -255,20 +244,13 @@ void task3_asciiSDF(){
 		PERF_START_MEASURING (PERFORMANCE_COUNTER_0_BASE);
 		PERF_BEGIN(PERFORMANCE_COUNTER_0_BASE, SECTION_1);
 
-		int h = *img2;
-		int w = *(img2 + 1);
+		// PPM order: width, height, max value
+		int w = *img2;
+		int h = *(img2 + 1);
 		unsigned char* data1 = img2 + 3;
 		
-		//Call asciSDF
-		unsigned char* ascii_pix = (unsigned char*)malloc(sizeof(unsigned char)*((w*h)+3));
-
-		//convert gray scale to ascii
-		asciiSDF(h, w , data1, ascii_pix);
-
-		//Print
-		printAscii(ascii_pix, h, w);
-
-		free(ascii_pix);
+		//Render and print the frame
+		asciiSDF(w, h, data1);
 		free(img2);	
 
 		PERF_END(PERFORMANCE_COUNTER_0_BASE, SECTION_1);  
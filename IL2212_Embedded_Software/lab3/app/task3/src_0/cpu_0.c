@@ -19,7 +19,10 @@
 #include "io.h"
 
 #include "images.h"
+#include "gray.h"
 #include "ascii_gray.h"
+#include "ascii.h"
+#include "tiles.h"
 
 #define DEBUG 1
 
@@ -35,6 +38,11 @@ OS_STK    StartTask_Stack[TASK_STACKSIZE];
 #define TASK1_PERIOD 10000
 
 #define SECTION_1 1
+
+/* 1: graySDF and asciiSDF only redo the tiles that changed since the
+   last frame and keep their output frames, 0: every pixel of every frame */
+#define INCREMENTAL 0
+
 /*
  * Example function for copying a p3 image from sram to the shared on-chip mempry
  */
@@ -64,30 +72,63 @@ void sram2sm_p3(unsigned char* base)
 /*
  * Global variables
  */
-void asciiSDF(int x, int y, unsigned char* pix, unsigned char* ascii){
-	//Copy code from lab2
-	//number of ascii values
-	int nlevels = sizeof(asciiChars) / sizeof(char);
-
-	//assign grayscale values to ascii
-	int n = 0;	
-	for(n = 0; n < x*y; n++){
-		int leveln = pix[n] / nlevels;
-		ascii[n] = asciiChars[leveln];
+// Text of the frame, rebuilt only when the frame size changes
+ascii_screen_t screen;
+char* screen_mem = NULL;
+
+void asciiSDF(int x, int y, unsigned char* pix){
+	// Table lookup per pixel, the whole frame goes out in one write
+	if(screen.w != x || screen.h != y){
+		free(screen_mem);
+		screen_mem = (char*)malloc(ASCII_SCREEN_BYTES(x, y));
+		ascii_screen_init(&screen, x, y, asciiChars, NR_ASCII_CHARS, ASCII_DIFF, screen_mem);
 	}
+	ascii_screen_show(&screen, pix, x);
 } 
 
-void conversion(unsigned char* rgb, unsigned char* gray){
-	*gray = rgb[0] * 0.3125 + rgb[1] * 0.5625 + rgb[2] * 0.125;
+void graySDF(int x, int y, unsigned char* rgb_pix, unsigned char* gray_pix){
+	// (5r + 9g + 2b) >> 4, bit-exact with the model, see gray.h
+	gray_convert(rgb_pix, gray_pix, x*y);
 }
 
-
-void graySDF(int x, int y, unsigned char* rgb_pix, unsigned char* gray_pix){
-	int n = 0;
-	for(n = 0; n < x*y; n++){
-		conversion(rgb_pix + 3*n, gray_pix + n);
-		//printf("%f ", gray_pix[n]);
+// Last frame, gray output and its text, kept between frames
+tiles_t tiles;
+unsigned char* tiles_mem = NULL;
+unsigned char* gray_cache = NULL;
+char* text_cache = NULL;
+char text_lut[256];
+
+// NULL if there is no memory for the kept frames
+unsigned char* grayIncremental(int x, int y, unsigned char* rgb_pix){
+	if(tiles_mem == NULL || tiles.w != x || tiles.h != y){
+		free(tiles_mem);
+		free(gray_cache);
+		free(text_cache);
+		tiles_mem = (unsigned char*)malloc(TILES_BYTES(x, y));
+		gray_cache = (unsigned char*)malloc(sizeof(unsigned char)*((x*y)+3));
+		text_cache = (char*)malloc(y*(x+1));
+		if(tiles_mem == NULL || gray_cache == NULL || text_cache == NULL){
+			free(tiles_mem);
+			free(gray_cache);
+			free(text_cache);
+			tiles_mem = NULL;
+			gray_cache = NULL;
+			text_cache = NULL;
+			return NULL;
+		}
+		// every tile is dirty in the first frame
+		tiles_init(&tiles, x, y, tiles_mem);
+		ascii_lut(text_lut, asciiChars, NR_ASCII_CHARS);
 	}
+	tiles_update(&tiles, rgb_pix, 3*x);
+	tiles_gray(&tiles, rgb_pix, 3*x, gray_cache + 3, x);
+	return gray_cache;
+}
+
+void asciiIncremental(int x, int y, unsigned char* pix){
+	// Text of the dirty tiles only, the whole frame still goes out in one write
+	tiles_ascii(&tiles, 1, pix, x, text_lut, text_cache);
+	ascii_write(text_cache, y*(x+1));
 }
 
 int main(void) {
@@ -128,15 +169,25 @@ while(1){
 		PERF_RESET(PERFORMANCE_COUNTER_0_BASE);
 		PERF_START_MEASURING (PERFORMANCE_COUNTER_0_BASE);
 		PERF_BEGIN(PERFORMANCE_COUNTER_0_BASE, SECTION_1);
-		int h = *img1;
-		int w = *(img1 + 1);
+		// PPM order: width, height, max value
+		int w = *img1;
+		int h = *(img1 + 1);
 		unsigned char* data = (int*)(img1 + 3);
 		// Call graysdf
+#if INCREMENTAL
+		unsigned char* gray_pix = grayIncremental(w, h, data);
+		if(gray_pix == NULL){
+			printf("Task2: no memory for the kept frames, frame skipped\n");
+			current_image=(current_image+1) % sequence_length;
+			continue;
+		}
+#else
 		unsigned char* gray_pix = (unsigned char*)malloc(sizeof(unsigned char)*((w*h)+3));
 		graySDF(w, h, data, gray_pix + 3);
+#endif
 
-		gray_pix[0] = h;
-		gray_pix[1] = w;
+		gray_pix[0] = w;
+		gray_pix[1] = h;
 		PERF_END(PERFORMANCE_COUNTER_0_BASE, SECTION_1);   
 		/* Print report */
 		perf_print_formatted_report
@@ -157,17 +208,13 @@ while(1){
 		unsigned char* img2 =gray_pix;
 		unsigned char* data1 = img2 + 3;
 
-		//Call asciSDF
-		unsigned char* ascii_pix = (unsigned char*)malloc(sizeof(unsigned char)*((w*h)+3));
-
-		//convert gray scale to ascii
-		asciiSDF(h, w , data1, ascii_pix);
-
-		//Print
-		printAscii(ascii_pix, h, w);
-
-		free(ascii_pix);
+		//Render and print the frame
+#if INCREMENTAL
+		asciiIncremental(w, h, data1);
+#else
+		asciiSDF(w, h, data1);
 		free(img2);	
+#endif
 		PERF_END(PERFORMANCE_COUNTER_0_BASE, SECTION_1); 
 		/* Print report */
 		perf_print_formatted_report
@@ -27,7 +27,7 @@ echo "BSP package creation finished"
 echo " "
 
 # Create Application
-nios2-app-generate-makefile --bsp-dir $BSP_DIR/$BSP --elf-name $APP.elf --src-dir src_0/ --set APP_CFLAGS_OPTIMIZATION -Os
+nios2-app-generate-makefile --bsp-dir $BSP_DIR/$BSP --elf-name $APP.elf --src-dir src_0/ --inc-dir ../../c-util/image-kernels --set APP_CFLAGS_OPTIMIZATION -Os
 
 # Create ELF-file
 make
@@ -22,7 +22,7 @@ void printAscii(unsigned char* image, int x_dim, int y_dim) {
   int l = 0;
   for(k = 0; k < y_dim; k++) {
     for(l = 0; l < x_dim; l++) {
-      unsigned char pixel = image[k * y_dim + l];
+      unsigned char pixel = image[k * x_dim + l];
       // Clamp pixel value to 255
       unsigned char c_pixel = pixel > 255 ? 255 : pixel;
       // Print normalized value as ASCII character
@@ -55,7 +55,7 @@ void printAsciiHidden(unsigned char* image, int x_dim, int y_dim,
 	unsigned char c_pixel = pixel > 255 ? 255 : pixel;
 	printf("%4c", asciiChars[((NR_ASCII_CHARS - 1) * c_pixel) / 255]);
       } else {
-	unsigned char pixel = image[k * y_dim + l];
+	unsigned char pixel = image[k * x_dim + l];
 	unsigned char c_pixel = pixel > 255 ? 255 : pixel;
 	printf("%4c", asciiChars[((NR_ASCII_CHARS - 1) * c_pixel) / 255]);	  
       }
@@ -19,7 +19,12 @@
 #include "io.h"
 
 #include "images.h"
+#include "gray.h"
+#include "gray_half.h"
+#include "resize.h"
 #include "ascii_gray.h"
+#include "ascii.h"
+#include "tiles.h"
 
 #define DEBUG 1
 
@@ -46,6 +51,15 @@ OS_STK    StartTask_Stack[TASK_STACKSIZE];
 
 #define SECTION_1 1
 
+/* 1: graySDF and resizeSDF run as one task (task2_grayResizeSDF) that
+   never builds the full size gray frame, 0: two tasks over Comm23Q */
+#define FUSED_GRAY_RESIZE 1
+
+/* 1: the gray, resize and ASCII stages only redo the tiles that changed
+   since the last frame and keep their output frames, 0: every pixel of
+   every frame */
+#define INCREMENTAL 0
+
 
 
 /*
@@ -91,6 +105,7 @@ alt_u32 alarm_handler(void* context)
 
 // Semaphores
 OS_EVENT *Task1TmrSem;
+OS_EVENT *TilesSem;
 
 // Message Queues
 OS_EVENT *Comm12Q;
@@ -104,41 +119,82 @@ void *Comm34Msg[1];
 // SW-Timer
 OS_TMR *Task1Tmr;
 
-void asciiSDF(int x, int y, unsigned char* pix, unsigned char* ascii){
-
-	//Copy code from lab2
-	//number of ascii values
-	int nlevels = sizeof(asciiChars) / sizeof(char);
+// Text of the frame, rebuilt only when the frame size changes
+ascii_screen_t screen;
+char* screen_mem = NULL;
 
-	//assign grayscale values to ascii
-	int n = 0;	
-	for(n = 0; n < x*y; n++){
-		int leveln = pix[n] / nlevels;
-		ascii[n] = asciiChars[leveln];
+void asciiSDF(int x, int y, unsigned char* pix){
+	// Table lookup per pixel, the whole frame goes out in one write
+	if(screen.w != x || screen.h != y){
+		free(screen_mem);
+		screen_mem = (char*)malloc(ASCII_SCREEN_BYTES(x, y));
+		ascii_screen_init(&screen, x, y, asciiChars, NR_ASCII_CHARS, ASCII_DIFF, screen_mem);
 	}
+	ascii_screen_show(&screen, pix, x);
 } 
 
-void conversion(unsigned char* rgb, unsigned char* gray){
-	*gray = rgb[0] * 0.3125 + rgb[1] * 0.5625 + rgb[2] * 0.125;
+void graySDF(int x, int y, unsigned char* rgb_pix, unsigned char* gray_pix){
+	// (5r + 9g + 2b) >> 4, bit-exact with the model, see gray.h
+	gray_convert(rgb_pix, gray_pix, x*y);
 }
 
+void resizeSDF(int width,int height, unsigned char* gray_pix, unsigned char* resized_pix){
+	// 2x2 mean, any size, safe in place, see resize.h
+	resize_half(gray_pix, width, height, width, resized_pix, width/2);
+}
 
-void graySDF(int x, int y, unsigned char* rgb_pix, unsigned char* gray_pix){
-	int n = 0;
-	for(n = 0; n < x*y; n++){
-		conversion(rgb_pix + 3*n, gray_pix + n);
+// Last frame and the output of every stage, kept between frames. A frame
+// holds them (TilesSem) from the gray stage until its text is sent, so
+// the next frame cannot change the tiles under a stage that still reads them
+tiles_t tiles;
+unsigned char* tiles_mem = NULL;
+unsigned char* gray_cache = NULL;
+unsigned char* resized_cache = NULL;
+char* text_cache = NULL;
+char text_lut[256];
+
+void tilesFree(){
+	free(tiles_mem);
+	free(gray_cache);
+	free(resized_cache);
+	free(text_cache);
+	tiles_mem = NULL;
+	gray_cache = NULL;
+	resized_cache = NULL;
+	text_cache = NULL;
+}
+
+// Kept frames for x by y RGB frames, 0 if there is no memory for them
+int tilesAlloc(int x, int y){
+	if(tiles_mem != NULL && tiles.w == x && tiles.h == y){
+		return 1;
 	}
+	tilesFree();
+	tiles_mem = (unsigned char*)malloc(TILES_BYTES(x, y));
+#if !FUSED_GRAY_RESIZE
+	gray_cache = (unsigned char*)malloc(sizeof(unsigned char)*((x*y)+3));
+	if(gray_cache == NULL){
+		tilesFree();
+		return 0;
+	}
+#endif
+	resized_cache = (unsigned char*)malloc(sizeof(unsigned char)*(((x/2)*(y/2))+3));
+	text_cache = (char*)malloc((y/2)*(x/2+1));
+	if(tiles_mem == NULL || resized_cache == NULL || text_cache == NULL){
+		tilesFree();
+		return 0;
+	}
+	// every tile is dirty in the first frame
+	tiles_init(&tiles, x, y, tiles_mem);
+	ascii_lut(text_lut, asciiChars, NR_ASCII_CHARS);
+	return 1;
 }
 
-void resizeSDF(int width,int height, unsigned char* gray_pix, unsigned char* resized_pix){
-	int y;
-	int x;
-	for (y = 0; y < height; y=y+2) {
-        for (x = 0; x < width; x=x+2) {  
-			resized_pix[16*y+x/2]=(gray_pix[64*y+x]+gray_pix[64*y+x+1]+gray_pix[64*y+x+64]+gray_pix[64*y+x+65])/4.0; 
-				}
-            }
-        }
+void asciiIncremental(int x, int y, unsigned char* pix){
+	// Text of the dirty tiles only, the whole frame still goes out in one write
+	tiles_ascii(&tiles, 2, pix, x, text_lut, text_cache);
+	ascii_write(text_cache, y*(x+1));
+}
 
 /* Timer Callback Functions */ 
 void Task1TmrCallback (void *ptmr, void *callback_arg){
@@ -201,23 +257,38 @@ void task2_graySDF(){
 		printf("Task2 start\n");
 
 		unsigned char* img = OSQPend(Comm12Q, 0, &err);
+#if INCREMENTAL
+		OSSemPend(TilesSem, 0, &err);
+#endif
 
 		PERF_RESET(PERFORMANCE_COUNTER_0_BASE);
 		PERF_START_MEASURING (PERFORMANCE_COUNTER_0_BASE);
 		PERF_BEGIN(PERFORMANCE_COUNTER_0_BASE, SECTION_1);
 
-		int h = *img;
-		int w = *(img + 1);
-		unsigned char* data = (int*)(img + 3);
+		// PPM order: width, height, max value
+		int w = *img;
+		int h = *(img + 1);
+		unsigned char* data = img + 3;
 		//printf("w,h = %d,%d\n", w, h);
 
 		// Call graysdf
+#if INCREMENTAL
+		if(!tilesAlloc(w, h)){
+			printf("Task2: no memory for the kept frames, frame skipped\n");
+			OSSemPost(TilesSem);
+			continue;
+		}
+		tiles_update(&tiles, data, 3*w);
+		unsigned char* gray_pix = gray_cache;
+		tiles_gray(&tiles, data, 3*w, gray_pix + 3, w);
+#else
 		unsigned char* gray_pix = (unsigned char*)malloc(sizeof(unsigned char)*((w*h)+3));
 
 		graySDF(w, h, data, gray_pix + 3);
+#endif
 	
-		gray_pix[0] = h;
-		gray_pix[1] = w;
+		gray_pix[0] = w;
+		gray_pix[1] = h;
 
 
 		PERF_END(PERFORMANCE_COUNTER_0_BASE, SECTION_1);  
@@ -242,6 +313,62 @@ void task2_graySDF(){
 
 }
 
+/* graySDF and resizeSDF fused: RGB frame in, half resolution gray out */
+void task2_grayResizeSDF(){
+	INT8U err;
+	while(1){
+		printf("Task2 start\n");
+
+		unsigned char* img = OSQPend(Comm12Q, 0, &err);
+#if INCREMENTAL
+		OSSemPend(TilesSem, 0, &err);
+#endif
+
+		PERF_RESET(PERFORMANCE_COUNTER_0_BASE);
+		PERF_START_MEASURING (PERFORMANCE_COUNTER_0_BASE);
+		PERF_BEGIN(PERFORMANCE_COUNTER_0_BASE, SECTION_1);
+
+		// PPM order: width, height, max value
+		int w = *img;
+		int h = *(img + 1);
+		unsigned char* data = img + 3;
+
+#if INCREMENTAL
+		if(!tilesAlloc(w, h)){
+			printf("Task2: no memory for the kept frames, frame skipped\n");
+			OSSemPost(TilesSem);
+			continue;
+		}
+		tiles_update(&tiles, data, 3*w);
+		unsigned char* resized_pix = resized_cache;
+		tiles_gray_half(&tiles, data, 3*w, resized_pix + 3, w/2);
+#else
+		unsigned char* resized_pix = (unsigned char*)malloc(sizeof(unsigned char)*(((w/2)*(h/2))+3));
+
+		gray_half(data, w, h, 3*w, resized_pix + 3, w/2);
+#endif
+		resized_pix[0] = w/2;
+		resized_pix[1] = h/2;
+
+		PERF_END(PERFORMANCE_COUNTER_0_BASE, SECTION_1);  
+
+		/* Print report */
+		perf_print_formatted_report
+		(PERFORMANCE_COUNTER_0_BASE,            
+		ALT_CPU_FREQ,        // defined in "system.h"
+		1,                   // How many sections to print
+		"task 2"        // Display-name of section(s).
+		);  
+
+		// Send to task4_asciiSDF
+		err = OS_ERR_Q_FULL;
+		while(err == OS_ERR_Q_FULL){
+ 			err =  OSQPost(Comm34Q, resized_pix);
+		}
+		printf("Task2 complete\n");
+	}
+}
+
 void task3_resizeSDF(){
 	INT8U err;
 	while(1){
@@ -252,18 +379,23 @@ void task3_resizeSDF(){
 		PERF_START_MEASURING (PERFORMANCE_COUNTER_0_BASE);
 		PERF_BEGIN(PERFORMANCE_COUNTER_0_BASE, SECTION_1);
 		
-		int h = *img2;
-		int w = *(img2 + 1);
+		int w = *img2;
+		int h = *(img2 + 1);
 		unsigned char* data2 = img2 + 3;
 
 		//Call resizeSDF
-		unsigned char* resized_pix = (unsigned char*)malloc(sizeof(unsigned char)*((w*h/4)+3));
+#if INCREMENTAL
+		unsigned char* resized_pix = resized_cache;
+		tiles_resize_half(&tiles, 1, data2, w, resized_pix + 3, w/2);
+#else
+		unsigned char* resized_pix = (unsigned char*)malloc(sizeof(unsigned char)*(((w/2)*(h/2))+3));
 		
 		//convert gray scale to resized_gray
 
 		resizeSDF(w, h,data2,resized_pix+3);
-		resized_pix[0] = h/2;
-		resized_pix[1] = w/2;
+#endif
+		resized_pix[0] = w/2;
+		resized_pix[1] = h/2;
 
 		PERF_END(PERFORMANCE_COUNTER_0_BASE, SECTION_1);  
 
@@ -300,21 +432,19 @@ void task4_asciiSDF(){
 		PERF_START_MEASURING (PERFORMANCE_COUNTER_0_BASE);
 		PERF_BEGIN(PERFORMANCE_COUNTER_0_BASE, SECTION_1);
 
-		int h = *img3;
-		int w = *(img3 + 1);
+		int w = *img3;
+		int h = *(img3 + 1);
 		unsigned char* data3 = img3 + 3;
 		
-		//Call asciSDF
-		unsigned char* ascii_pix = (unsigned char*)malloc(sizeof(unsigned char)*((w*h)+3));
-
-		//convert gray scale to ascii
-		asciiSDF(h, w , data3, ascii_pix);
-
-		//Print
-		printAscii(ascii_pix, h, w);
-
-		free(ascii_pix);
+		//Render and print the frame
+#if INCREMENTAL
+		asciiIncremental(w, h, data3);
+		// the next frame may change the tiles now
+		OSSemPost(TilesSem);
+#else
+		asciiSDF(w, h, data3);
 		free(img3);	
+#endif
 
 		PERF_END(PERFORMANCE_COUNTER_0_BASE, SECTION_1);  
 
@@ -402,6 +532,7 @@ void StartTask(void* pdata)
    */
 
   Task1TmrSem = OSSemCreate(0);   
+  TilesSem = OSSemCreate(1);
 
   /*
    * Create statistics task
@@ -429,6 +560,27 @@ void StartTask(void* pdata)
     }
    }  
 
+#if FUSED_GRAY_RESIZE
+	//Task 2, gray and resize fused
+	OSTaskCreateExt(
+	 task2_grayResizeSDF, // Pointer to task code
+         NULL,      // Pointer to argument that is
+                    // passed to task
+         (void *)&task2_stk[TASK_STACKSIZE-1], // Pointer to top
+						     // of task stack 
+         TASK2_PRIORITY,
+         TASK2_PRIORITY,
+         task2_stk,
+         TASK_STACKSIZE,
+         NULL,
+		 0);
+
+  if (DEBUG) {
+     if (err == OS_ERR_NONE) { //if start successful
+      printf("Task2 created\n");
+    }
+   }  
+#else
 	//Task 2
 	OSTaskCreateExt(
 	 task2_graySDF, // Pointer to task code
@@ -468,6 +620,7 @@ void StartTask(void* pdata)
       printf("Task3 created\n");
     }
    }  
+#endif
 
 	//Task4
 	OSTaskCreateExt(
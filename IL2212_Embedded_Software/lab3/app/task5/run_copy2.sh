@@ -67,6 +67,7 @@ nios2-app-generate-makefile \
     --bsp-dir ${BSP_PATH}_0 \
     --elf-name ${APP}_0.elf \
     --src-dir ${SRC_PATH}_0/ \
+    --inc-dir ../../c-util/image-kernels \
     --set APP_CFLAGS_OPTIMIZATION -Os
 
 echo "" > log.txt
@@ -111,6 +112,7 @@ for i in `seq 1 $NODES`; do
 	--bsp-dir ${BSP_PATH}_$i \
 	--elf-name ${APP}_$i.elf \
 	--src-dir ${SRC_PATH}_$i/ \
+	--inc-dir ../../c-util/image-kernels \
 	--set APP_CFLAGS_OPTIMIZATION -Os
 
     # Create ELF-file
@@ -1,4 +1,5 @@
 #include "images.h"
+#include "gray.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include "system.h"
@@ -40,23 +41,9 @@ void sram2sm_p3(unsigned char* base)
 }
 
 
-void conversion(unsigned char* rgb, unsigned char* gray){
-
-	*gray = rgb[0] * 0.3125 + rgb[1] * 0.5625 + rgb[2] * 0.125;
-}
-
-
 void graySDF(int x, int y, unsigned char* rgb_pix, unsigned char* gray_pix){
-
-	//Copy code from lab2
-	// split into arrays of 3 [rgb]
-	// apply conversion of each array
-	// re-combine all arrays into single array	
-	// return an array of doubles	
-	int n = 0;
-	for(n = 0; n < x*y; n++){
-		conversion(rgb_pix + 3*n, gray_pix + n);
-	}
+	// (5r + 9g + 2b) >> 4, bit-exact with the model, see gray.h
+	gray_convert(rgb_pix, gray_pix, x*y);
 }
 
 
@@ -88,9 +75,10 @@ int main()
 
 		unsigned char* img_orig = image_sequence[current_image];
 
-		*height = *img_orig;
-		*width = *(img_orig + 1);
-		unsigned char* data = (int*)(img_orig + 3);
+		// PPM order: width, height, max value
+		*width = *img_orig;
+		*height = *(img_orig + 1);
+		unsigned char* data = img_orig + 3;
 
 		// Call graysdf. Save output in shared memory
 		graySDF(*width, *height, data, img);
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include "system.h"
 #include "io.h"
+#include "resize.h"
 
 #define TRUE 1
 
@@ -8,13 +9,8 @@
 
 //RESIZE SDF
 void resizeSDF(int width,int height, unsigned char* gray_pix, unsigned char* resized_pix){
-	int y;
-	int x;
-	for (y = 0; y < height; y=y+2) {
-        for (x = 0; x < width; x=x+2) {  
-			resized_pix[16*y+x/2]=(gray_pix[64*y+x]+gray_pix[64*y+x+1]+gray_pix[64*y+x+64]+gray_pix[64*y+x+65])/4.0; 
-		}
-    }
+	// 2x2 mean, any size, safe in place, see resize.h
+	resize_half(gray_pix, width, height, width, resized_pix, width/2);
 }
 
 extern void delay (int millisec);
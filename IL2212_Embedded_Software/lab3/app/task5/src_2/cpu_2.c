@@ -1,4 +1,5 @@
 #include "../src_0/ascii_gray.h"
+#include "ascii.h"
 #include <stdio.h>
 //#include <stdlib.h>
 #include "system.h"
@@ -11,21 +12,23 @@
 
 extern void delay (int millisec);
 
+/* Largest frame the text buffer is sized for */
+#define ASCII_MAX_W 64
+#define ASCII_MAX_H 64
+
+ascii_screen_t screen;
+char screen_mem[ASCII_SCREEN_BYTES(ASCII_MAX_W, ASCII_MAX_H)];
+
 void asciiSDF(int x, int y, unsigned char* pix){
-	//Copy code from lab2
-	//number of ascii values
-	int nlevels = sizeof(asciiChars) / sizeof(char);
-
-	//assign grayscale values to ascii
-	int n = 0;	
-	for(n = 0; n < x*y; n++){
-		int leveln = pix[n] / nlevels;
-		//ascii[n] = asciiChars[leveln];		    
-        putchar(asciiChars[leveln]);
-        if ((n + 1) % x == 0) {
-            putchar('\n');  // Start a new line after each row
-          }
+	// Table lookup per pixel, the whole frame goes out in one write
+	if(x > ASCII_MAX_W || y > ASCII_MAX_H){
+		printf("asciiSDF: %dx%d frame too large\n", x, y);
+		return;
+	}
+	if(screen.w != x || screen.h != y){
+		ascii_screen_init(&screen, x, y, asciiChars, NR_ASCII_CHARS, ASCII_DIFF, screen_mem);
 	}
+	ascii_screen_show(&screen, pix, x);
 } 
 
 int main()
@@ -53,7 +56,7 @@ while (1) {
 		//PERF_BEGIN(PERFORMANCE_COUNTER_0_BASE, SECTION_1);
 
 		//convert gray scale to ascii
-		asciiSDF(*height, *width , img);
+		asciiSDF(*width, *height, img);
 
 		//PERF_END(PERFORMANCE_COUNTER_0_BASE, SECTION_1);  
 
@@ -0,0 +1,168 @@
+#ifndef ASCII_H
+#define ASCII_H
+
+/*
+ * toAsciiArt of the model and its output over the JTAG UART.
+ *
+ * The level of a pixel is ((n - 1) * p) / 255 for n characters, the
+ * mapping of printAscii and of the model. It only depends on the byte, so
+ * it is a 256 entry table built once (ascii_lut), and rendering is one
+ * load per pixel with no multiply or divide.
+ *
+ * A screen (ascii_screen_t) renders a whole frame, newlines included, into
+ * a buffer given at init and hands it to the driver with one write. The
+ * UART cost per call is then paid once per frame instead of once per
+ * pixel.
+ *
+ * In diff mode the screen keeps the text of the last frame. The first
+ * frame clears the terminal; later frames only send the rows that changed,
+ * each after a cursor move to its line, and end with the cursor below the
+ * frame. That needs an ANSI terminal and nothing else printing in between.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Default mode of the screens the tasks set up: 1 sends only the rows
+   that changed, with cursor moves (needs an ANSI terminal), 0 every
+   frame in full. Define it before the include to change it. */
+#ifndef ASCII_DIFF
+#define ASCII_DIFF 0
+#endif
+
+/* Longest cursor move: ESC [ row ; 1 H with a 5 digit row */
+#define ASCII_MOVE_MAX 11
+
+/* Memory ascii_screen_init needs for a w x h frame */
+#define ASCII_SCREEN_BYTES(w, h) (2 * (h) * ((w) + 1) + ((h) + 1) * ASCII_MOVE_MAX + 8)
+
+typedef struct {
+  char lut[256];
+  int w, h;
+  int diff;
+  int drawn;   /* diff mode: text holds what the terminal shows */
+  char* text;  /* h rows of w characters and a newline */
+  char* out;   /* bytes of the next write */
+} ascii_screen_t;
+
+/* Character of every gray value for the n characters in chars */
+static inline void ascii_lut(char* lut, const char* chars, int n)
+{
+  int p;
+  for(p = 0; p < 256; p++) {
+    lut[p] = chars[((n - 1) * p) / 255];
+  }
+}
+
+static inline char* ascii_row(const unsigned char* row, int w, const char* lut, char* dst)
+{
+  int x;
+  for(x = 0; x < w; x++) {
+    dst[x] = lut[row[x]];
+  }
+  return dst + w;
+}
+
+/* w x h frame to text with a newline per row, h * (w + 1) bytes */
+static inline int ascii_render(const unsigned char* img, int w, int h, int stride,
+                               const char* lut, char* buf)
+{
+  char* p = buf;
+  int y;
+  for(y = 0; y < h; y++) {
+    p = ascii_row(img + y * stride, w, lut, p);
+    *p++ = '\n';
+  }
+  return p - buf;
+}
+
+/* ESC [ line ; 1 H, lines counted from 1 */
+static inline char* ascii_move(char* p, int line)
+{
+  char digits[8];
+  int n = 0;
+  *p++ = '\033';
+  *p++ = '[';
+  do {
+    digits[n++] = '0' + line % 10;
+    line /= 10;
+  } while(line);
+  while(n) {
+    *p++ = digits[--n];
+  }
+  *p++ = ';';
+  *p++ = '1';
+  *p++ = 'H';
+  return p;
+}
+
+/* mem holds ASCII_SCREEN_BYTES(w, h) bytes and stays owned by the caller */
+static inline void ascii_screen_init(ascii_screen_t* s, int w, int h,
+                                     const char* chars, int n, int diff, void* mem)
+{
+  ascii_lut(s->lut, chars, n);
+  s->w = w;
+  s->h = h;
+  s->diff = diff;
+  s->drawn = 0;
+  s->text = (char*) mem;
+  s->out = s->text + h * (w + 1);
+}
+
+/* Bytes for the frame in s->out, returns how many */
+static inline int ascii_screen_frame(ascii_screen_t* s, const unsigned char* img, int stride)
+{
+  char* p = s->out;
+  int line = s->w + 1;
+  int y;
+
+  if(!s->diff) {
+    return ascii_render(img, s->w, s->h, stride, s->lut, s->out);
+  }
+  if(!s->drawn) {
+    /* home and clear, then the whole frame */
+    memcpy(p, "\033[H\033[2J", 7);
+    p += 7;
+    p += ascii_render(img, s->w, s->h, stride, s->lut, p);
+    memcpy(s->text, s->out + 7, s->h * line);
+    s->drawn = 1;
+    return p - s->out;
+  }
+  for(y = 0; y < s->h; y++) {
+    /* render after the move and drop both if the row is the same */
+    char* row = ascii_move(p, y + 1);
+    char* end = ascii_row(img + y * stride, s->w, s->lut, row);
+    if(memcmp(row, s->text + y * line, s->w) != 0) {
+      memcpy(s->text + y * line, row, s->w);
+      p = end;
+    }
+  }
+  if(p != s->out) {
+    p = ascii_move(p, s->h + 1);
+  }
+  return p - s->out;
+}
+
+/* Send n bytes of text to stdout, in one write unless it is cut short */
+static inline void ascii_write(const char* p, int n)
+{
+  /* keep the order with what printf still holds */
+  fflush(stdout);
+  while(n > 0) {
+    int k = write(STDOUT_FILENO, p, n);
+    if(k <= 0) {
+      break;
+    }
+    p += k;
+    n -= k;
+  }
+}
+
+/* Render and send a frame to stdout with one write */
+static inline void ascii_screen_show(ascii_screen_t* s, const unsigned char* img, int stride)
+{
+  ascii_write(s->out, ascii_screen_frame(s, img, stride));
+}
+
+#endif
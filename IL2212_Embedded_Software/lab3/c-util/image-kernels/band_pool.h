@@ -0,0 +1,371 @@
+#ifndef BAND_POOL_H
+#define BAND_POOL_H
+
+/*
+ * Parallel for over the rows of a frame, for the host tools that run the
+ * kernels over recorded sequences. Host only: build with -pthread.
+ *
+ * A pool keeps its threads between calls; the caller is thread 0 and
+ * works too. band_for cuts rows 0 to rows - 1 into bands of equal size
+ * (about four per thread, at least grain rows) and the threads take the
+ * bands in turn until none is left. The cut only depends on the number
+ * of rows and threads, and every band writes its own output rows, so the
+ * output is the same as the serial kernels whatever thread runs what.
+ *
+ * Stencils read a few rows past their band, the halo: sobel output rows
+ * y0 to y1 - 1 read input rows y0 to y1 + 1. When the input is a frame
+ * that is already there, the halo is just read. When it is the output of
+ * an earlier stage of the same pass (band_process: correction then
+ * sobel), each band computes its halo rows again into its own scratch
+ * lines, which is 2 rows more per band instead of a barrier.
+ */
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "gray.h"
+#include "gray_half.h"
+#include "resize.h"
+#include "brightness.h"
+#include "sobel.h"
+#include "ascii.h"
+
+#define BAND_MAX_THREADS 64
+/* Bands per thread, so that a slow thread does not hold up the rest */
+#define BAND_SPLIT 4
+
+/* Rows y0 to y1 - 1, on thread 0 to n - 1 of the pool */
+typedef void (*band_fn)(void* ctx, int y0, int y1, int thread);
+
+struct band_pool_t;
+
+typedef struct {
+  struct band_pool_t* pool;
+  int id;
+  pthread_t thread;
+} band_worker_t;
+
+typedef struct band_pool_t {
+  int n;
+  band_worker_t workers[BAND_MAX_THREADS];
+  pthread_mutex_t lock;
+  pthread_cond_t go, done;
+  unsigned int job;     /* bumped for every band_for */
+  int busy;             /* workers still in the job */
+  int stop;
+  /* current job */
+  band_fn fn;
+  void* ctx;
+  int rows, band, bands;
+  atomic_int next;
+} band_pool_t;
+
+/* Rows per band for a job of the given rows */
+static inline int band_size(const band_pool_t* p, int rows, int grain)
+{
+  int parts = p->n * BAND_SPLIT;
+  int band = (rows + parts - 1) / parts;
+  return band < grain ? grain : band < 1 ? 1 : band;
+}
+
+static inline void band_run(band_pool_t* p, int id)
+{
+  int b;
+  while((b = atomic_fetch_add_explicit(&p->next, 1, memory_order_relaxed)) < p->bands) {
+    int y0 = b * p->band, y1 = y0 + p->band;
+    p->fn(p->ctx, y0, y1 < p->rows ? y1 : p->rows, id);
+  }
+}
+
+static void* band_worker_main(void* arg)
+{
+  band_worker_t* w = (band_worker_t*) arg;
+  band_pool_t* p = w->pool;
+  unsigned int seen = 0;
+
+  for(;;) {
+    pthread_mutex_lock(&p->lock);
+    while(p->job == seen && !p->stop) {
+      pthread_cond_wait(&p->go, &p->lock);
+    }
+    if(p->stop) {
+      pthread_mutex_unlock(&p->lock);
+      return NULL;
+    }
+    seen = p->job;
+    pthread_mutex_unlock(&p->lock);
+
+    band_run(p, w->id);
+
+    pthread_mutex_lock(&p->lock);
+    if(--p->busy == 0) {
+      pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+  }
+}
+
+/* n threads in all, the caller included; 0 for one per online core */
+static inline void band_pool_init(band_pool_t* p, int n)
+{
+  int i;
+  if(n <= 0) {
+    n = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  n = n < 1 ? 1 : n > BAND_MAX_THREADS ? BAND_MAX_THREADS : n;
+  p->n = n;
+  p->job = 0;
+  p->busy = 0;
+  p->stop = 0;
+  atomic_init(&p->next, 0);
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->go, NULL);
+  pthread_cond_init(&p->done, NULL);
+  for(i = 1; i < n; i++) {
+    p->workers[i].pool = p;
+    p->workers[i].id = i;
+    if(pthread_create(&p->workers[i].thread, NULL, band_worker_main, &p->workers[i]) != 0) {
+      /* run with the threads that did start */
+      p->n = i;
+      break;
+    }
+  }
+}
+
+static inline void band_pool_destroy(band_pool_t* p)
+{
+  int i;
+  pthread_mutex_lock(&p->lock);
+  p->stop = 1;
+  pthread_cond_broadcast(&p->go);
+  pthread_mutex_unlock(&p->lock);
+  for(i = 1; i < p->n; i++) {
+    pthread_join(p->workers[i].thread, NULL);
+  }
+  pthread_cond_destroy(&p->done);
+  pthread_cond_destroy(&p->go);
+  pthread_mutex_destroy(&p->lock);
+}
+
+/* fn over rows 0 to rows - 1 in bands of at least grain rows; returns when all are done */
+static inline void band_for(band_pool_t* p, int rows, int grain, band_fn fn, void* ctx)
+{
+  if(rows <= 0) {
+    return;
+  }
+  p->fn = fn;
+  p->ctx = ctx;
+  p->rows = rows;
+  p->band = band_size(p, rows, grain);
+  p->bands = (rows + p->band - 1) / p->band;
+  atomic_store_explicit(&p->next, 0, memory_order_relaxed);
+  if(p->n > 1 && p->bands > 1) {
+    pthread_mutex_lock(&p->lock);
+    p->busy = p->n - 1;
+    p->job++;
+    pthread_cond_broadcast(&p->go);
+    pthread_mutex_unlock(&p->lock);
+  }
+
+  band_run(p, 0);
+
+  if(p->n > 1 && p->bands > 1) {
+    pthread_mutex_lock(&p->lock);
+    while(p->busy > 0) {
+      pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+  }
+}
+
+/* Frame kernels on the pool. Arguments as in the serial versions. */
+
+typedef struct {
+  const unsigned char* in;
+  unsigned char* out;
+  int w, h, in_stride, out_stride, mode;
+  const char* lut;
+  /* band_process */
+  unsigned char* gray;
+  unsigned char* scratch;
+  unsigned char* lo;
+  unsigned char* hi;
+  int band;
+  correction_t p;
+} band_job_t;
+
+static void band_gray_rows(void* ctx, int y0, int y1, int thread)
+{
+  band_job_t* j = (band_job_t*) ctx;
+  int y;
+  (void) thread;
+  for(y = y0; y < y1; y++) {
+    gray_convert(j->in + y * j->in_stride, j->out + y * j->out_stride, j->w);
+  }
+}
+
+static inline void band_gray(band_pool_t* p, const unsigned char* rgb, int w, int h, int rgb_stride,
+                             unsigned char* out, int out_stride)
+{
+  band_job_t j;
+  j.in = rgb;
+  j.out = out;
+  j.w = w;
+  j.in_stride = rgb_stride;
+  j.out_stride = out_stride;
+  band_for(p, h, 8, band_gray_rows, &j);
+}
+
+static void band_resize_rows(void* ctx, int y0, int y1, int thread)
+{
+  band_job_t* j = (band_job_t*) ctx;
+  int y;
+  (void) thread;
+  for(y = y0; y < y1; y++) {
+    resize_row(j->in + 2 * y * j->in_stride, j->in + (2 * y + 1) * j->in_stride,
+               j->out + y * j->out_stride, j->w);
+  }
+}
+
+/* Not in place: a band could overwrite input rows of the band before it */
+static inline void band_resize_half(band_pool_t* p, const unsigned char* in, int w, int h, int in_stride,
+                                    unsigned char* out, int out_stride)
+{
+  band_job_t j;
+  j.in = in;
+  j.out = out;
+  j.w = w;
+  j.in_stride = in_stride;
+  j.out_stride = out_stride;
+  band_for(p, h / 2, 8, band_resize_rows, &j);
+}
+
+static void band_sobel_rows(void* ctx, int y0, int y1, int thread)
+{
+  band_job_t* j = (band_job_t*) ctx;
+  (void) thread;
+  sobel_band(j->in, j->w, j->h, j->in_stride, j->out, j->out_stride, y0, y1, j->mode);
+}
+
+static inline void band_sobel(band_pool_t* p, const unsigned char* in, int w, int h, int in_stride,
+                              unsigned char* out, int out_stride, int mode)
+{
+  band_job_t j;
+  j.in = in;
+  j.out = out;
+  j.w = w;
+  j.h = h;
+  j.in_stride = in_stride;
+  j.out_stride = out_stride;
+  j.mode = mode;
+  band_for(p, h - 2, 8, band_sobel_rows, &j);
+}
+
+static void band_ascii_rows(void* ctx, int y0, int y1, int thread)
+{
+  band_job_t* j = (band_job_t*) ctx;
+  (void) thread;
+  ascii_render(j->in + y0 * j->in_stride, j->w, y1 - y0, j->in_stride, j->lut,
+               (char*) j->out + y0 * (j->w + 1));
+}
+
+/* ascii_render on the pool, h * (w + 1) bytes */
+static inline int band_ascii(band_pool_t* p, const unsigned char* img, int w, int h, int stride,
+                             const char* lut, char* buf)
+{
+  band_job_t j;
+  j.in = img;
+  j.out = (unsigned char*) buf;
+  j.w = w;
+  j.in_stride = stride;
+  j.lut = lut;
+  band_for(p, h, 8, band_ascii_rows, &j);
+  return h * (w + 1);
+}
+
+/* Pass 1 of band_process: gray rows of the band and their min/max */
+static void band_gray_half_rows(void* ctx, int y0, int y1, int thread)
+{
+  band_job_t* j = (band_job_t*) ctx;
+  int gw = j->w / 2, b = y0 / j->band, y;
+  (void) thread;
+  j->lo[b] = 255;
+  j->hi[b] = 0;
+  for(y = y0; y < y1; y++) {
+    unsigned char* g = j->gray + y * gw;
+    gray_half_row(j->in + 2 * y * j->in_stride, j->in + (2 * y + 1) * j->in_stride, g, j->w);
+    brightness_row(g, gw, &j->lo[b], &j->hi[b]);
+  }
+}
+
+/* Pass 2: corrected rows y0 to y1 + 1 in the thread's lines, then sobel */
+static void band_sobel_corrected_rows(void* ctx, int y0, int y1, int thread)
+{
+  band_job_t* j = (band_job_t*) ctx;
+  int gw = j->w / 2;
+  unsigned char* lines = j->scratch + thread * (j->band + 2) * gw;
+  int y;
+  for(y = y0; y < y1 + 2; y++) {
+    correction_row(j->gray + y * gw, lines + (y - y0) * gw, gw, j->p);
+  }
+  for(y = y0; y < y1; y++) {
+    sobel_row(lines + (y - y0) * gw, lines + (y - y0 + 1) * gw, lines + (y - y0 + 2) * gw,
+              j->out + y * j->out_stride, gw, j->mode);
+  }
+}
+
+/*
+ * gray, resize, brightness, control, correction and sobel of a w x h RGB
+ * frame, the same as pipeline.h in PIPELINE_STORE mode: out gets the
+ * (w / 2 - 2) x (h / 2 - 2) frame and control moves on by one frame.
+ * gray holds (w / 2) * (h / 2) bytes. Returns -1 if out of memory.
+ */
+static inline int band_process(band_pool_t* p, control_t* control, const unsigned char* rgb,
+                               int w, int h, int rgb_stride, unsigned char* out, int out_stride,
+                               unsigned char* gray, int mode)
+{
+  int gw = w / 2, gh = h / 2, b, bands;
+  unsigned char hmin = 255, hmax = 0;
+  band_job_t j;
+
+  j.in = rgb;
+  j.out = out;
+  j.w = w;
+  j.in_stride = rgb_stride;
+  j.out_stride = out_stride;
+  j.mode = mode;
+  j.gray = gray;
+
+  /* min/max per band, folded in band order */
+  j.band = band_size(p, gh, 8);
+  bands = (gh + j.band - 1) / j.band;
+  j.lo = (unsigned char*) malloc(2 * (bands > 0 ? bands : 1));
+  if(!j.lo) {
+    return -1;
+  }
+  j.hi = j.lo + bands;
+  band_for(p, gh, 8, band_gray_half_rows, &j);
+  for(b = 0; b < bands; b++) {
+    hmin = j.lo[b] < hmin ? j.lo[b] : hmin;
+    hmax = j.hi[b] > hmax ? j.hi[b] : hmax;
+  }
+  free(j.lo);
+
+  j.p = correction_params(hmin, hmax, control_enabled(control));
+  control_update(control, hmin, hmax);
+  if(gw < 3 || gh < 3) {
+    return 0;
+  }
+  j.band = band_size(p, gh - 2, 8);
+  j.scratch = (unsigned char*) malloc((size_t) p->n * (j.band + 2) * gw);
+  if(!j.scratch) {
+    return -1;
+  }
+  band_for(p, gh - 2, 8, band_sobel_corrected_rows, &j);
+  free(j.scratch);
+  return 0;
+}
+
+#endif
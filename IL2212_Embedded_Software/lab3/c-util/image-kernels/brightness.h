@@ -0,0 +1,250 @@
+#ifndef BRIGHTNESS_H
+#define BRIGHTNESS_H
+
+/*
+ * brightness, correction and the control actor of the model on byte
+ * frames.
+ *
+ * brightness is a min/max reduction. It works a row at a time
+ * (brightness_row), so the stage producing the frame (resize) can feed it
+ * while the row is still in cache, and the frame is read only once.
+ *
+ * correction rescales by 2, 4, 8 or 16 depending on hmax - hmin. With
+ * integer pixels, (h - hmin) * 2^k is at most (hmax - hmin) * 2^k, which
+ * is below 256 in every bucket, so the result is an exact byte:
+ * (h - hmin) << k. A range above 127 (and a disabled control) leaves the
+ * pixel as it is, which is the same formula with hmin = 0 and k = 0, so
+ * the whole stage is one subtract and one shift per pixel, done in place
+ * (correction) or while copying a row into the next stage (correction_row).
+ * The kernels saturate: a pixel below hmin gives 0 and h - hmin is
+ * clamped to 255 >> k first. That changes nothing for the frame the
+ * parameters were measured on, and keeps a frame corrected with the
+ * parameters of the frame before it (pipeline.h) free of wrap-around.
+ *
+ * control follows controlSDF: the correction of a frame is enabled when
+ * the mean range of the three frames before it is below 128, starting
+ * from three ranges of 255.
+ */
+
+#include "resize.h"
+
+/* Subtract and shift of one frame */
+typedef struct {
+  unsigned char hmin;
+  unsigned char shift;
+} correction_t;
+
+/* Ranges of the last three frames, newest first */
+typedef struct {
+  int levels[3];
+} control_t;
+
+static inline void control_init(control_t* c)
+{
+  c->levels[0] = c->levels[1] = c->levels[2] = 255;
+}
+
+/* Correction enabled for the frame about to be processed */
+static inline int control_enabled(const control_t* c)
+{
+  /* mean < 128 without the division */
+  return c->levels[0] + c->levels[1] + c->levels[2] < 3 * 128;
+}
+
+/* Shift in the range of the frame just measured */
+static inline void control_update(control_t* c, int hmin, int hmax)
+{
+  c->levels[2] = c->levels[1];
+  c->levels[1] = c->levels[0];
+  c->levels[0] = hmax - hmin;
+}
+
+/* correctionFunc: the rescale for a frame with the given min and max */
+static inline correction_t correction_params(int hmin, int hmax, int enabled)
+{
+  correction_t p;
+  int range = hmax - hmin;
+
+  p.hmin = hmin;
+  if(!enabled || range > 127) {
+    p.hmin = 0;
+    p.shift = 0;
+  } else if(range > 63) {
+    p.shift = 1;
+  } else if(range > 31) {
+    p.shift = 2;
+  } else if(range > 15) {
+    p.shift = 3;
+  } else {
+    p.shift = 4;
+  }
+  return p;
+}
+
+static inline void brightness_row_scalar(const unsigned char* row, int w,
+                                         unsigned char* hmin, unsigned char* hmax)
+{
+  unsigned char lo = *hmin, hi = *hmax;
+  int x;
+  for(x = 0; x < w; x++) {
+    lo = row[x] < lo ? row[x] : lo;
+    hi = row[x] > hi ? row[x] : hi;
+  }
+  *hmin = lo;
+  *hmax = hi;
+}
+
+static inline void correction_row_scalar(const unsigned char* in, unsigned char* out, int w, correction_t p)
+{
+  const int lim = 255 >> p.shift;
+  int x;
+  for(x = 0; x < w; x++) {
+    int v = in[x] > p.hmin ? in[x] - p.hmin : 0;
+    out[x] = (unsigned char) ((v < lim ? v : lim) << p.shift);
+  }
+}
+
+#if defined(__SSE2__) || defined(__AVX2__)
+/* Lowest and highest byte of a register */
+static inline void brightness_fold_sse2(__m128i lo, __m128i hi, unsigned char* hmin, unsigned char* hmax)
+{
+  lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+  lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+  lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 2));
+  lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 1));
+  hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+  hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+  hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 2));
+  hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 1));
+  *hmin = (unsigned char) _mm_cvtsi128_si32(lo);
+  *hmax = (unsigned char) _mm_cvtsi128_si32(hi);
+}
+
+static inline void brightness_row_sse2(const unsigned char* row, int w,
+                                       unsigned char* hmin, unsigned char* hmax)
+{
+  __m128i lo = _mm_set1_epi8((char) *hmin), hi = _mm_set1_epi8((char) *hmax);
+  int x;
+  for(x = 0; x + 16 <= w; x += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (row + x));
+    lo = _mm_min_epu8(lo, v);
+    hi = _mm_max_epu8(hi, v);
+  }
+  brightness_fold_sse2(lo, hi, hmin, hmax);
+  brightness_row_scalar(row + x, w - x, hmin, hmax);
+}
+
+/* Byte shift as a 16 bit shift: after the clamp no bit crosses into the
+   next byte */
+static inline void correction_row_sse2(const unsigned char* in, unsigned char* out, int w, correction_t p)
+{
+  const __m128i hmin = _mm_set1_epi8((char) p.hmin);
+  const __m128i lim = _mm_set1_epi8((char) (255 >> p.shift));
+  const __m128i shift = _mm_cvtsi32_si128(p.shift);
+  int x;
+  for(x = 0; x + 16 <= w; x += 16) {
+    __m128i v = _mm_subs_epu8(_mm_loadu_si128((const __m128i*) (in + x)), hmin);
+    _mm_storeu_si128((__m128i*) (out + x), _mm_sll_epi16(_mm_min_epu8(v, lim), shift));
+  }
+  correction_row_scalar(in + x, out + x, w - x, p);
+}
+#endif
+
+#if defined(__AVX2__)
+static inline void brightness_row_avx2(const unsigned char* row, int w,
+                                       unsigned char* hmin, unsigned char* hmax)
+{
+  __m256i lo = _mm256_set1_epi8((char) *hmin), hi = _mm256_set1_epi8((char) *hmax);
+  int x;
+  for(x = 0; x + 32 <= w; x += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) (row + x));
+    lo = _mm256_min_epu8(lo, v);
+    hi = _mm256_max_epu8(hi, v);
+  }
+  brightness_fold_sse2(_mm_min_epu8(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1)),
+                       _mm_max_epu8(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1)),
+                       hmin, hmax);
+  brightness_row_sse2(row + x, w - x, hmin, hmax);
+}
+
+static inline void correction_row_avx2(const unsigned char* in, unsigned char* out, int w, correction_t p)
+{
+  const __m256i hmin = _mm256_set1_epi8((char) p.hmin);
+  const __m256i lim = _mm256_set1_epi8((char) (255 >> p.shift));
+  const __m128i shift = _mm_cvtsi32_si128(p.shift);
+  int x;
+  for(x = 0; x + 32 <= w; x += 32) {
+    __m256i v = _mm256_subs_epu8(_mm256_loadu_si256((const __m256i*) (in + x)), hmin);
+    _mm256_storeu_si256((__m256i*) (out + x), _mm256_sll_epi16(_mm256_min_epu8(v, lim), shift));
+  }
+  correction_row_sse2(in + x, out + x, w - x, p);
+}
+#endif
+
+/* Best versions for the target */
+
+/* Fold a row into hmin and hmax, which start at 255 and 0 */
+static inline void brightness_row(const unsigned char* row, int w, unsigned char* hmin, unsigned char* hmax)
+{
+#if defined(__AVX2__)
+  brightness_row_avx2(row, w, hmin, hmax);
+#elif defined(__SSE2__)
+  brightness_row_sse2(row, w, hmin, hmax);
+#else
+  brightness_row_scalar(row, w, hmin, hmax);
+#endif
+}
+
+/* Corrected copy of a row, in may be out */
+static inline void correction_row(const unsigned char* in, unsigned char* out, int w, correction_t p)
+{
+#if defined(__AVX2__)
+  correction_row_avx2(in, out, w, p);
+#elif defined(__SSE2__)
+  correction_row_sse2(in, out, w, p);
+#else
+  correction_row_scalar(in, out, w, p);
+#endif
+}
+
+/* Min and max of a w x h frame */
+static inline void brightness(const unsigned char* img, int w, int h, int stride,
+                              unsigned char* hmin, unsigned char* hmax)
+{
+  int y;
+  *hmin = 255;
+  *hmax = 0;
+  for(y = 0; y < h; y++) {
+    brightness_row(img + y * stride, w, hmin, hmax);
+  }
+}
+
+/* resize_half and brightness in one pass: each output row is folded into
+   hmin and hmax right after it is written */
+static inline void resize_brightness(const unsigned char* in, int w, int h, int in_stride,
+                                     unsigned char* out, int out_stride,
+                                     unsigned char* hmin, unsigned char* hmax)
+{
+  int y;
+  *hmin = 255;
+  *hmax = 0;
+  for(y = 0; y < h / 2; y++) {
+    unsigned char* row = out + y * out_stride;
+    resize_row(in + 2 * y * in_stride, in + (2 * y + 1) * in_stride, row, w);
+    brightness_row(row, w / 2, hmin, hmax);
+  }
+}
+
+/* Correct a w x h frame in place */
+static inline void correction(unsigned char* img, int w, int h, int stride, correction_t p)
+{
+  int y;
+  if(p.hmin == 0 && p.shift == 0) {
+    return;
+  }
+  for(y = 0; y < h; y++) {
+    correction_row(img + y * stride, img + y * stride, w, p);
+  }
+}
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef GRAY_H
+#define GRAY_H
+
+/*
+ * RGB to grayscale, gray = 0.3125 r + 0.5625 g + 0.125 b as in the model.
+ *
+ * The coefficients are 5/16, 9/16 and 2/16, so the double expression
+ * truncated to a byte is exactly (5r + 9g + 2b) >> 4 for every input: the
+ * sum is at most 16 * 255 and never needs more than 12 bits.
+ *
+ * gray_convert picks the widest version the compiler targets: AVX2 (32
+ * pixels per step), SSSE3 (16 pixels per step) or the scalar loop, which
+ * is the one built for the Nios II. The SIMD versions need pshufb to
+ * split the interleaved RGB bytes, which SSE2 does not have; build the
+ * host tools with -mssse3 or -mavx2 (or -march=native).
+ */
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+/* One pixel */
+static inline unsigned char gray_pixel(unsigned int r, unsigned int g, unsigned int b)
+{
+  return (unsigned char) ((5 * r + 9 * g + 2 * b) >> 4);
+}
+
+/* n interleaved RGB pixels from rgb to n gray pixels in gray */
+static inline void gray_convert_scalar(const unsigned char* rgb, unsigned char* gray, int n)
+{
+  int i;
+  for(i = 0; i < n; i++) {
+    gray[i] = gray_pixel(rgb[0], rgb[1], rgb[2]);
+    rgb += 3;
+  }
+}
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+/*
+ * Shuffles for four pixels starting 'o' bytes into a 16 byte window: the
+ * (r, g) pairs and the (b, 0) pairs as 16 bit lanes, placed in the low or
+ * in the high half of the register. pmaddubsw against (5, 9) and (2, 0)
+ * then gives 5r + 9g and 2b per lane.
+ */
+#define GRAY_RG(o, h) \
+  (char) (h ? -1 : o + 0), (char) (h ? -1 : o + 1), (char) (h ? -1 : o + 3), (char) (h ? -1 : o + 4), \
+  (char) (h ? -1 : o + 6), (char) (h ? -1 : o + 7), (char) (h ? -1 : o + 9), (char) (h ? -1 : o + 10), \
+  (char) (h ? o + 0 : -1), (char) (h ? o + 1 : -1), (char) (h ? o + 3 : -1), (char) (h ? o + 4 : -1), \
+  (char) (h ? o + 6 : -1), (char) (h ? o + 7 : -1), (char) (h ? o + 9 : -1), (char) (h ? o + 10 : -1)
+#define GRAY_B(o, h) \
+  (char) (h ? -1 : o + 2), -1, (char) (h ? -1 : o + 5), -1, \
+  (char) (h ? -1 : o + 8), -1, (char) (h ? -1 : o + 11), -1, \
+  (char) (h ? o + 2 : -1), -1, (char) (h ? o + 5 : -1), -1, \
+  (char) (h ? o + 8 : -1), -1, (char) (h ? o + 11 : -1), -1
+
+/*
+ * 16 pixels from four windows: w0 and w1 hold pixels 0-3 and 4-7 from
+ * byte 0, w2 holds pixels 8-11 from byte 0 and w3 pixels 12-15 from
+ * byte 4 (it is loaded 4 bytes early to stay inside the 48 input bytes).
+ */
+static inline __m128i gray_16_ssse3(__m128i w0, __m128i w1, __m128i w2, __m128i w3)
+{
+  const __m128i rg_lo = _mm_setr_epi8(GRAY_RG(0, 0));
+  const __m128i rg_hi = _mm_setr_epi8(GRAY_RG(0, 1));
+  const __m128i rg_hi4 = _mm_setr_epi8(GRAY_RG(4, 1));
+  const __m128i b_lo = _mm_setr_epi8(GRAY_B(0, 0));
+  const __m128i b_hi = _mm_setr_epi8(GRAY_B(0, 1));
+  const __m128i b_hi4 = _mm_setr_epi8(GRAY_B(4, 1));
+  const __m128i c_rg = _mm_set1_epi16(5 | (9 << 8));
+  const __m128i c_b = _mm_set1_epi16(2);
+
+  __m128i rg0 = _mm_or_si128(_mm_shuffle_epi8(w0, rg_lo), _mm_shuffle_epi8(w1, rg_hi));
+  __m128i b0 = _mm_or_si128(_mm_shuffle_epi8(w0, b_lo), _mm_shuffle_epi8(w1, b_hi));
+  __m128i rg1 = _mm_or_si128(_mm_shuffle_epi8(w2, rg_lo), _mm_shuffle_epi8(w3, rg_hi4));
+  __m128i b1 = _mm_or_si128(_mm_shuffle_epi8(w2, b_lo), _mm_shuffle_epi8(w3, b_hi4));
+
+  __m128i s0 = _mm_add_epi16(_mm_maddubs_epi16(rg0, c_rg), _mm_maddubs_epi16(b0, c_b));
+  __m128i s1 = _mm_add_epi16(_mm_maddubs_epi16(rg1, c_rg), _mm_maddubs_epi16(b1, c_b));
+
+  return _mm_packus_epi16(_mm_srli_epi16(s0, 4), _mm_srli_epi16(s1, 4));
+}
+
+/* 16 pixels from 48 bytes of interleaved RGB */
+static inline __m128i gray_load_16_ssse3(const unsigned char* p)
+{
+  return gray_16_ssse3(_mm_loadu_si128((const __m128i*) p),
+                       _mm_loadu_si128((const __m128i*) (p + 12)),
+                       _mm_loadu_si128((const __m128i*) (p + 24)),
+                       _mm_loadu_si128((const __m128i*) (p + 32)));
+}
+
+static inline void gray_convert_ssse3(const unsigned char* rgb, unsigned char* gray, int n)
+{
+  int i;
+  for(i = 0; i + 16 <= n; i += 16) {
+    _mm_storeu_si128((__m128i*) (gray + i), gray_load_16_ssse3(rgb + 3 * i));
+  }
+  gray_convert_scalar(rgb + 3 * i, gray + i, n - i);
+}
+#endif
+
+#if defined(__AVX2__)
+/* Same shuffles in both 128 bit lanes, the high lane 16 pixels further on */
+static inline __m256i gray_load2(const unsigned char* p)
+{
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) p)),
+                                 _mm_loadu_si128((const __m128i*) (p + 48)), 1);
+}
+
+/* 32 pixels from 96 bytes of interleaved RGB, in order */
+static inline __m256i gray_load_32_avx2(const unsigned char* p)
+{
+  const __m256i rg_lo = _mm256_setr_epi8(GRAY_RG(0, 0), GRAY_RG(0, 0));
+  const __m256i rg_hi = _mm256_setr_epi8(GRAY_RG(0, 1), GRAY_RG(0, 1));
+  const __m256i rg_hi4 = _mm256_setr_epi8(GRAY_RG(4, 1), GRAY_RG(4, 1));
+  const __m256i b_lo = _mm256_setr_epi8(GRAY_B(0, 0), GRAY_B(0, 0));
+  const __m256i b_hi = _mm256_setr_epi8(GRAY_B(0, 1), GRAY_B(0, 1));
+  const __m256i b_hi4 = _mm256_setr_epi8(GRAY_B(4, 1), GRAY_B(4, 1));
+  const __m256i c_rg = _mm256_set1_epi16(5 | (9 << 8));
+  const __m256i c_b = _mm256_set1_epi16(2);
+
+  __m256i w0 = gray_load2(p);
+  __m256i w1 = gray_load2(p + 12);
+  __m256i w2 = gray_load2(p + 24);
+  __m256i w3 = gray_load2(p + 32);
+
+  __m256i rg0 = _mm256_or_si256(_mm256_shuffle_epi8(w0, rg_lo), _mm256_shuffle_epi8(w1, rg_hi));
+  __m256i b0 = _mm256_or_si256(_mm256_shuffle_epi8(w0, b_lo), _mm256_shuffle_epi8(w1, b_hi));
+  __m256i rg1 = _mm256_or_si256(_mm256_shuffle_epi8(w2, rg_lo), _mm256_shuffle_epi8(w3, rg_hi4));
+  __m256i b1 = _mm256_or_si256(_mm256_shuffle_epi8(w2, b_lo), _mm256_shuffle_epi8(w3, b_hi4));
+
+  __m256i s0 = _mm256_add_epi16(_mm256_maddubs_epi16(rg0, c_rg), _mm256_maddubs_epi16(b0, c_b));
+  __m256i s1 = _mm256_add_epi16(_mm256_maddubs_epi16(rg1, c_rg), _mm256_maddubs_epi16(b1, c_b));
+
+  /* packus works per lane, which keeps pixels 0-15 low and 16-31 high */
+  return _mm256_packus_epi16(_mm256_srli_epi16(s0, 4), _mm256_srli_epi16(s1, 4));
+}
+
+static inline void gray_convert_avx2(const unsigned char* rgb, unsigned char* gray, int n)
+{
+  int i;
+  for(i = 0; i + 32 <= n; i += 32) {
+    _mm256_storeu_si256((__m256i*) (gray + i), gray_load_32_avx2(rgb + 3 * i));
+  }
+  gray_convert_ssse3(rgb + 3 * i, gray + i, n - i);
+}
+#endif
+
+/* Best version for the target */
+static inline void gray_convert(const unsigned char* rgb, unsigned char* gray, int n)
+{
+#if defined(__AVX2__)
+  gray_convert_avx2(rgb, gray, n);
+#elif defined(__SSSE3__)
+  gray_convert_ssse3(rgb, gray, n);
+#else
+  gray_convert_scalar(rgb, gray, n);
+#endif
+}
+
+#endif
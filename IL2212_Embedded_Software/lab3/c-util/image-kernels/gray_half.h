@@ -0,0 +1,97 @@
+#ifndef GRAY_HALF_H
+#define GRAY_HALF_H
+
+/*
+ * graySDF and resizeSDF fused: two RGB rows in, one row of half
+ * resolution gray out, with no full size gray frame in between.
+ *
+ * Every output pixel is the truncated mean of the four gray pixels of a
+ * 2x2 block, each gray pixel truncated as in gray.h, so the result is
+ * bit-exact with running gray_convert and then the 2x2 resize. An odd last
+ * column or row is dropped like groupV 2 does in the model.
+ */
+
+#include "gray.h"
+
+/* w RGB pixels of rows rgb0 and rgb1 to w / 2 gray pixels in out */
+static inline void gray_half_row_scalar(const unsigned char* rgb0, const unsigned char* rgb1,
+                                        unsigned char* out, int w)
+{
+  int x;
+  for(x = 0; x < w / 2; x++) {
+    const unsigned char* a = rgb0 + 6 * x;
+    const unsigned char* b = rgb1 + 6 * x;
+    out[x] = (gray_pixel(a[0], a[1], a[2]) + gray_pixel(a[3], a[4], a[5]) +
+              gray_pixel(b[0], b[1], b[2]) + gray_pixel(b[3], b[4], b[5])) >> 2;
+  }
+}
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+/* 32 input pixels per row, 16 output pixels per step */
+static inline void gray_half_row_ssse3(const unsigned char* rgb0, const unsigned char* rgb1,
+                                       unsigned char* out, int w)
+{
+  const __m128i ones = _mm_set1_epi8(1);
+  int x;
+
+  for(x = 0; x + 32 <= w; x += 32) {
+    /* pmaddubsw against ones adds the horizontal pairs into 16 bit lanes */
+    __m128i s0 = _mm_add_epi16(_mm_maddubs_epi16(gray_load_16_ssse3(rgb0 + 3 * x), ones),
+                               _mm_maddubs_epi16(gray_load_16_ssse3(rgb1 + 3 * x), ones));
+    __m128i s1 = _mm_add_epi16(_mm_maddubs_epi16(gray_load_16_ssse3(rgb0 + 3 * x + 48), ones),
+                               _mm_maddubs_epi16(gray_load_16_ssse3(rgb1 + 3 * x + 48), ones));
+    _mm_storeu_si128((__m128i*) (out + x / 2),
+                     _mm_packus_epi16(_mm_srli_epi16(s0, 2), _mm_srli_epi16(s1, 2)));
+  }
+  gray_half_row_scalar(rgb0 + 3 * x, rgb1 + 3 * x, out + x / 2, w - x);
+}
+#endif
+
+#if defined(__AVX2__)
+/* 64 input pixels per row, 32 output pixels per step */
+static inline void gray_half_row_avx2(const unsigned char* rgb0, const unsigned char* rgb1,
+                                      unsigned char* out, int w)
+{
+  const __m256i ones = _mm256_set1_epi8(1);
+  int x;
+
+  for(x = 0; x + 64 <= w; x += 64) {
+    __m256i s0 = _mm256_add_epi16(_mm256_maddubs_epi16(gray_load_32_avx2(rgb0 + 3 * x), ones),
+                                  _mm256_maddubs_epi16(gray_load_32_avx2(rgb1 + 3 * x), ones));
+    __m256i s1 = _mm256_add_epi16(_mm256_maddubs_epi16(gray_load_32_avx2(rgb0 + 3 * x + 96), ones),
+                                  _mm256_maddubs_epi16(gray_load_32_avx2(rgb1 + 3 * x + 96), ones));
+    /* packus per lane gives outputs 0-7, 16-23 | 8-15, 24-31 */
+    __m256i p = _mm256_packus_epi16(_mm256_srli_epi16(s0, 2), _mm256_srli_epi16(s1, 2));
+    _mm256_storeu_si256((__m256i*) (out + x / 2), _mm256_permute4x64_epi64(p, 0xd8));
+  }
+  gray_half_row_ssse3(rgb0 + 3 * x, rgb1 + 3 * x, out + x / 2, w - x);
+}
+#endif
+
+/* Best version for the target */
+static inline void gray_half_row(const unsigned char* rgb0, const unsigned char* rgb1,
+                                 unsigned char* out, int w)
+{
+#if defined(__AVX2__)
+  gray_half_row_avx2(rgb0, rgb1, out, w);
+#elif defined(__SSSE3__)
+  gray_half_row_ssse3(rgb0, rgb1, out, w);
+#else
+  gray_half_row_scalar(rgb0, rgb1, out, w);
+#endif
+}
+
+/*
+ * w x h RGB frame to a (w / 2) x (h / 2) gray frame. Strides are in bytes
+ * per row: 3 * w and w / 2 for packed frames.
+ */
+static inline void gray_half(const unsigned char* rgb, int w, int h, int rgb_stride,
+                             unsigned char* out, int out_stride)
+{
+  int y;
+  for(y = 0; y < h / 2; y++) {
+    gray_half_row(rgb + 2 * y * rgb_stride, rgb + (2 * y + 1) * rgb_stride, out + y * out_stride, w);
+  }
+}
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+/*
+ * imageProcessingSDF of the model as a row stream: gray, resize,
+ * brightness, control, correction and sobel, with the output rows handed
+ * to a sink (for the ASCII stage, ascii_row of ascii.h).
+ *
+ * Every pair of RGB rows becomes one half resolution gray row
+ * (gray_half_row) that is folded into the min and max of the frame right
+ * away. sobel needs three corrected rows, so it works on a ring of three
+ * lines and gives the sink an output row as soon as the third one is in.
+ *
+ * Correction needs the min and max of the whole frame before it can
+ * start. There are two modes for that:
+ *
+ * - PIPELINE_DELAYED corrects frame n with the min and max of frame n - 1.
+ *   The control is still the one of the model. Only one RGB row, three
+ *   gray rows and an output row are kept, so memory is O(w). For a steady
+ *   sequence this is the model; the saturating correction keeps pixels
+ *   outside the old range from wrapping around.
+ * - PIPELINE_STORE keeps the gray frame, a quarter of the input pixels,
+ *   and runs correction and sobel when its last row is in. The output is
+ *   the same as running the frame kernels one after the other.
+ *
+ * The memory is given at init (PIPELINE_BYTES), so on the Nios it can be
+ * a static or on-chip buffer. Frames are at least 2 x 2.
+ *
+ * A tracker (tracker.h) set in p->tracker after init sees the same RGB
+ * rows, so the object position comes out of the same pass over the frame.
+ */
+
+#include <string.h>
+
+#include "gray_half.h"
+#include "brightness.h"
+#include "sobel.h"
+#include "tracker.h"
+
+#define PIPELINE_DELAYED 0
+#define PIPELINE_STORE   1
+
+/* Memory pipeline_init needs for w x h input frames */
+#define PIPELINE_BYTES(w, h, mode) \
+  (3 * (w) + (((mode) == PIPELINE_STORE ? (h) / 2 : 3) + 1) * ((w) / 2))
+
+/* Row y of the (w / 2 - 2) x (h / 2 - 2) output frame, w pixels */
+typedef void (*pipeline_sink)(void* ctx, const unsigned char* row, int y, int w);
+
+typedef struct {
+  int w, h;
+  int mode;
+  int sobel_mode;
+  pipeline_sink sink;
+  void* ctx;
+  control_t control;
+  int enabled;                 /* control of the current frame */
+  correction_t p;              /* correction of the current frame */
+  unsigned char hmin, hmax;    /* current frame so far */
+  unsigned char last_hmin, last_hmax;
+  int y;                       /* input rows of the current frame */
+  unsigned char* rgb;          /* even input row */
+  unsigned char* lines;        /* ring of three gray rows, or the gray frame */
+  unsigned char* out;          /* output row */
+  tracker_t* tracker;          /* or NULL */
+} pipeline_t;
+
+/* mem holds PIPELINE_BYTES(w, h, mode) bytes and stays owned by the caller */
+static inline void pipeline_init(pipeline_t* p, int w, int h, int mode, int sobel_mode,
+                                 pipeline_sink sink, void* ctx, void* mem)
+{
+  p->w = w;
+  p->h = h;
+  p->mode = mode;
+  p->sobel_mode = sobel_mode;
+  p->sink = sink;
+  p->ctx = ctx;
+  control_init(&p->control);
+  p->last_hmin = 0;
+  p->last_hmax = 255;
+  p->y = 0;
+  p->rgb = (unsigned char*) mem;
+  p->lines = p->rgb + 3 * w;
+  p->out = p->lines + (mode == PIPELINE_STORE ? h / 2 : 3) * (w / 2);
+  p->tracker = NULL;
+}
+
+static inline void pipeline_begin(pipeline_t* p)
+{
+  p->hmin = 255;
+  p->hmax = 0;
+  p->enabled = control_enabled(&p->control);
+  p->p = correction_params(p->last_hmin, p->last_hmax, p->enabled);
+}
+
+static inline void pipeline_sobel(pipeline_t* p, const unsigned char* a, const unsigned char* b,
+                                  const unsigned char* c, int y)
+{
+  int gw = p->w / 2;
+  if(gw < 3) {
+    return;
+  }
+  sobel_row(a, b, c, p->out, gw, p->sobel_mode);
+  p->sink(p->ctx, p->out, y, gw - 2);
+}
+
+/* Rows 2 * gy and 2 * gy + 1 of the input frame */
+static inline void pipeline_pair(pipeline_t* p, const unsigned char* rgb0, const unsigned char* rgb1, int gy)
+{
+  int gw = p->w / 2;
+  unsigned char* g;
+
+  if(p->mode == PIPELINE_STORE) {
+    g = p->lines + gy * gw;
+    gray_half_row(rgb0, rgb1, g, p->w);
+    brightness_row(g, gw, &p->hmin, &p->hmax);
+    return;
+  }
+  g = p->lines + gy % 3 * gw;
+  gray_half_row(rgb0, rgb1, g, p->w);
+  brightness_row(g, gw, &p->hmin, &p->hmax);
+  correction_row(g, g, gw, p->p);
+  if(gy >= 2) {
+    pipeline_sobel(p, p->lines + (gy - 2) % 3 * gw, p->lines + (gy - 1) % 3 * gw, g, gy - 2);
+  }
+}
+
+static inline void pipeline_end(pipeline_t* p)
+{
+  int gw = p->w / 2, gh = p->h / 2;
+  int y;
+
+  if(p->mode == PIPELINE_STORE) {
+    p->p = correction_params(p->hmin, p->hmax, p->enabled);
+    correction(p->lines, gw, gh, gw, p->p);
+    for(y = 0; y + 2 < gh; y++) {
+      pipeline_sobel(p, p->lines + y * gw, p->lines + (y + 1) * gw, p->lines + (y + 2) * gw, y);
+    }
+  }
+  control_update(&p->control, p->hmin, p->hmax);
+  p->last_hmin = p->hmin;
+  p->last_hmax = p->hmax;
+  p->y = 0;
+}
+
+/* Next RGB row of the stream, 3 * w bytes; it may be overwritten after the call */
+static inline void pipeline_row(pipeline_t* p, const unsigned char* rgb)
+{
+  if(p->y == 0) {
+    pipeline_begin(p);
+    if(p->tracker) {
+      tracker_begin(p->tracker, p->w, p->h);
+    }
+  }
+  if(p->tracker) {
+    tracker_row(p->tracker, rgb, p->y);
+  }
+  if(p->y % 2 == 0) {
+    memcpy(p->rgb, rgb, 3 * p->w);
+  } else {
+    pipeline_pair(p, p->rgb, rgb, p->y / 2);
+  }
+  if(++p->y == p->h) {
+    pipeline_end(p);
+  }
+}
+
+/* A whole frame in memory, without copying rows; not in the middle of a frame */
+static inline void pipeline_frame(pipeline_t* p, const unsigned char* rgb, int stride)
+{
+  int gy;
+  pipeline_begin(p);
+  if(p->tracker) {
+    tracker_frame(p->tracker, rgb, p->w, p->h, stride);
+  }
+  for(gy = 0; gy < p->h / 2; gy++) {
+    pipeline_pair(p, rgb + 2 * gy * stride, rgb + (2 * gy + 1) * stride, gy);
+  }
+  pipeline_end(p);
+}
+
+#endif
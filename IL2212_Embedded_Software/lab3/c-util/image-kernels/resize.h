@@ -0,0 +1,113 @@
+#ifndef RESIZE_H
+#define RESIZE_H
+
+/*
+ * resize of the model, mapMatrix (/4) . sumRows . sumCols: every output
+ * pixel is the sum of a 2x2 block divided by 4, truncated to a byte as
+ * the tasks do, which is sum >> 2. A w x h frame gives (w / 2) x (h / 2);
+ * an odd last column or row is dropped like groupV 2 does.
+ *
+ * Strides are in bytes per row, so the kernels work on any frame size and
+ * on a window of a larger frame. Out may be the same buffer as in (cpu_1
+ * of task5 resizes the shared frame in place) as long as out_stride is at
+ * most 2 * in_stride: every output byte lands at or before input bytes
+ * that have already been read.
+ *
+ * The SIMD versions take even and odd bytes apart with a mask and a shift,
+ * which SSE2 can do; AVX2 handles twice as many pixels per step.
+ */
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* w pixels of rows in0 and in1 to w / 2 pixels in out */
+static inline void resize_row_scalar(const unsigned char* in0, const unsigned char* in1,
+                                     unsigned char* out, int w)
+{
+  int x;
+  for(x = 0; x < w / 2; x++) {
+    out[x] = (in0[2 * x] + in0[2 * x + 1] + in1[2 * x] + in1[2 * x + 1]) >> 2;
+  }
+}
+
+#if defined(__SSE2__) || defined(__AVX2__)
+/* 32 input pixels per row, 16 output pixels per step */
+static inline void resize_row_sse2(const unsigned char* in0, const unsigned char* in1,
+                                   unsigned char* out, int w)
+{
+  const __m128i even = _mm_set1_epi16(0x00ff);
+  int x;
+
+  for(x = 0; x + 32 <= w; x += 32) {
+    __m128i a0 = _mm_loadu_si128((const __m128i*) (in0 + x));
+    __m128i a1 = _mm_loadu_si128((const __m128i*) (in0 + x + 16));
+    __m128i b0 = _mm_loadu_si128((const __m128i*) (in1 + x));
+    __m128i b1 = _mm_loadu_si128((const __m128i*) (in1 + x + 16));
+
+    /* 16 bit sums of the 2x2 blocks, at most 4 * 255 */
+    __m128i s0 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a0, even), _mm_srli_epi16(a0, 8)),
+                               _mm_add_epi16(_mm_and_si128(b0, even), _mm_srli_epi16(b0, 8)));
+    __m128i s1 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a1, even), _mm_srli_epi16(a1, 8)),
+                               _mm_add_epi16(_mm_and_si128(b1, even), _mm_srli_epi16(b1, 8)));
+
+    _mm_storeu_si128((__m128i*) (out + x / 2),
+                     _mm_packus_epi16(_mm_srli_epi16(s0, 2), _mm_srli_epi16(s1, 2)));
+  }
+  resize_row_scalar(in0 + x, in1 + x, out + x / 2, w - x);
+}
+#endif
+
+#if defined(__AVX2__)
+/* 64 input pixels per row, 32 output pixels per step */
+static inline void resize_row_avx2(const unsigned char* in0, const unsigned char* in1,
+                                   unsigned char* out, int w)
+{
+  const __m256i even = _mm256_set1_epi16(0x00ff);
+  int x;
+
+  for(x = 0; x + 64 <= w; x += 64) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i*) (in0 + x));
+    __m256i a1 = _mm256_loadu_si256((const __m256i*) (in0 + x + 32));
+    __m256i b0 = _mm256_loadu_si256((const __m256i*) (in1 + x));
+    __m256i b1 = _mm256_loadu_si256((const __m256i*) (in1 + x + 32));
+
+    __m256i s0 = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a0, even), _mm256_srli_epi16(a0, 8)),
+                                  _mm256_add_epi16(_mm256_and_si256(b0, even), _mm256_srli_epi16(b0, 8)));
+    __m256i s1 = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a1, even), _mm256_srli_epi16(a1, 8)),
+                                  _mm256_add_epi16(_mm256_and_si256(b1, even), _mm256_srli_epi16(b1, 8)));
+
+    /* packus per lane gives outputs 0-7, 16-23 | 8-15, 24-31 */
+    __m256i p = _mm256_packus_epi16(_mm256_srli_epi16(s0, 2), _mm256_srli_epi16(s1, 2));
+    _mm256_storeu_si256((__m256i*) (out + x / 2), _mm256_permute4x64_epi64(p, 0xd8));
+  }
+  resize_row_sse2(in0 + x, in1 + x, out + x / 2, w - x);
+}
+#endif
+
+/* Best version for the target */
+static inline void resize_row(const unsigned char* in0, const unsigned char* in1,
+                              unsigned char* out, int w)
+{
+#if defined(__AVX2__)
+  resize_row_avx2(in0, in1, out, w);
+#elif defined(__SSE2__)
+  resize_row_sse2(in0, in1, out, w);
+#else
+  resize_row_scalar(in0, in1, out, w);
+#endif
+}
+
+/* w x h frame to a (w / 2) x (h / 2) frame, in place if out == in */
+static inline void resize_half(const unsigned char* in, int w, int h, int in_stride,
+                               unsigned char* out, int out_stride)
+{
+  int y;
+  for(y = 0; y < h / 2; y++) {
+    resize_row(in + 2 * y * in_stride, in + (2 * y + 1) * in_stride, out + y * out_stride, w);
+  }
+}
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef SOBEL_H
+#define SOBEL_H
+
+/*
+ * sobel of the model: gx and gy from the 3x3 Sobel stencils, magnitude
+ * sqrt(gx^2 + gy^2) / 4, margins dropped. A w x h frame gives a
+ * (w - 2) x (h - 2) frame.
+ *
+ * The stencils are separable. Per input row a difference
+ * d = p[x+1] - p[x-1] and a smoothing s = p[x-1] + 2 p[x] + p[x+1] are
+ * computed, and then gx = d[y-1] + 2 d[y] + d[y+1], gy = s[y+1] - s[y-1].
+ * |gx| and |gy| are at most 4 * 255, so 16 bits are enough.
+ *
+ * sobel_reference gives the doubles of the model. The byte versions
+ * truncate like the tasks do and clamp to 255 (the magnitude goes up to
+ * 360):
+ *
+ * - SOBEL_EXACT is bit-exact with the reference. floor(sqrt(S) / 4) is
+ *   floor(sqrt(S >> 4)), an integer square root of at most 16 bits, which
+ *   takes 8 steps without a table. The SIMD versions use the float square
+ *   root, which is exact here.
+ * - SOBEL_L1 gives (|gx| + |gy|) / 4. It needs no square root and is never
+ *   below the exact value and never more than sqrt(2) times it.
+ *
+ * The frame is processed in bands of output rows (sobel_band), so a band
+ * can be given to another core or thread. Each band needs the two rows
+ * around it as input.
+ */
+
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define SOBEL_EXACT 0
+#define SOBEL_L1    1
+
+/* Model: (w - 2) x (h - 2) doubles, packed */
+static inline void sobel_reference(const unsigned char* in, int w, int h, int in_stride, double* out)
+{
+  int x, y;
+  for(y = 1; y < h - 1; y++) {
+    const unsigned char* a = in + (y - 1) * in_stride;
+    const unsigned char* b = in + y * in_stride;
+    const unsigned char* c = in + (y + 1) * in_stride;
+    for(x = 1; x < w - 1; x++) {
+      double gx = -a[x - 1] + a[x + 1] - 2.0 * b[x - 1] + 2.0 * b[x + 1] - c[x - 1] + c[x + 1];
+      double gy = -a[x - 1] - 2.0 * a[x] - a[x + 1] + c[x - 1] + 2.0 * c[x] + c[x + 1];
+      *out++ = sqrt(gx * gx + gy * gy) / 4;
+    }
+  }
+}
+
+/* floor(sqrt(n)) for n < 2^16, one result bit per step */
+static inline unsigned int sobel_isqrt16(unsigned int n)
+{
+  unsigned int r = 0, bit;
+  for(bit = 1 << 7; bit; bit >>= 1) {
+    unsigned int t = r | bit;
+    if(t * t <= n) {
+      r = t;
+    }
+  }
+  return r;
+}
+
+static inline unsigned char sobel_magnitude(int gx, int gy, int mode)
+{
+  unsigned int m;
+  if(mode == SOBEL_L1) {
+    m = (unsigned int) ((gx < 0 ? -gx : gx) + (gy < 0 ? -gy : gy)) >> 2;
+  } else {
+    unsigned int s = (unsigned int) (gx * gx + gy * gy) >> 4;
+    m = s >= 256 * 256 ? 255 : sobel_isqrt16(s);
+  }
+  return m > 255 ? 255 : m;
+}
+
+/* Output row from input rows a, b, c (above, at, below): w - 2 pixels */
+static inline void sobel_row_scalar(const unsigned char* a, const unsigned char* b, const unsigned char* c,
+                                    unsigned char* out, int w, int mode)
+{
+  int x;
+  for(x = 1; x < w - 1; x++) {
+    int d0 = a[x + 1] - a[x - 1], d1 = b[x + 1] - b[x - 1], d2 = c[x + 1] - c[x - 1];
+    int s0 = a[x - 1] + 2 * a[x] + a[x + 1], s2 = c[x - 1] + 2 * c[x] + c[x + 1];
+    out[x - 1] = sobel_magnitude(d0 + 2 * d1 + d2, s2 - s0, mode);
+  }
+}
+
+#if defined(__SSE2__) || defined(__AVX2__)
+/* 8 pixels of one row at p - 1, p and p + 1 as 16 bit lanes */
+#define SOBEL_LOAD8(p, o) _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) ((p) + (o))), _mm_setzero_si128())
+
+/* 8 output pixels per step */
+static inline void sobel_row_sse2(const unsigned char* a, const unsigned char* b, const unsigned char* c,
+                                  unsigned char* out, int w, int mode)
+{
+  int x;
+
+  for(x = 1; x + 9 <= w; x += 8) {
+    __m128i a0 = SOBEL_LOAD8(a, x - 1), a1 = SOBEL_LOAD8(a, x), a2 = SOBEL_LOAD8(a, x + 1);
+    __m128i b0 = SOBEL_LOAD8(b, x - 1), b2 = SOBEL_LOAD8(b, x + 1);
+    __m128i c0 = SOBEL_LOAD8(c, x - 1), c1 = SOBEL_LOAD8(c, x), c2 = SOBEL_LOAD8(c, x + 1);
+
+    __m128i d1 = _mm_sub_epi16(b2, b0);
+    __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(a2, a0), _mm_sub_epi16(c2, c0)),
+                               _mm_add_epi16(d1, d1));
+    __m128i gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(c0, c2), _mm_add_epi16(c1, c1)),
+                               _mm_add_epi16(_mm_add_epi16(a0, a2), _mm_add_epi16(a1, a1)));
+    __m128i m;
+
+    if(mode == SOBEL_L1) {
+      /* |v| = max(v, -v); the sum of both is at most 2040 */
+      __m128i ax = _mm_max_epi16(gx, _mm_sub_epi16(_mm_setzero_si128(), gx));
+      __m128i ay = _mm_max_epi16(gy, _mm_sub_epi16(_mm_setzero_si128(), gy));
+      m = _mm_srli_epi16(_mm_add_epi16(ax, ay), 2);
+    } else {
+      /* gx^2 + gy^2 from interleaved (gx, gy) pairs, then sqrt((S >> 4)) */
+      __m128i s0 = _mm_srli_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(gx, gy), _mm_unpacklo_epi16(gx, gy)), 4);
+      __m128i s1 = _mm_srli_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(gx, gy), _mm_unpackhi_epi16(gx, gy)), 4);
+      __m128i r0 = _mm_cvttps_epi32(_mm_sqrt_ps(_mm_cvtepi32_ps(s0)));
+      __m128i r1 = _mm_cvttps_epi32(_mm_sqrt_ps(_mm_cvtepi32_ps(s1)));
+      m = _mm_packs_epi32(r0, r1);
+    }
+    _mm_storel_epi64((__m128i*) (out + x - 1), _mm_packus_epi16(m, m));
+  }
+  if(x < w - 1) {
+    sobel_row_scalar(a + x - 1, b + x - 1, c + x - 1, out + x - 1, w - x + 1, mode);
+  }
+}
+#endif
+
+#if defined(__AVX2__)
+#define SOBEL_LOAD16(p, o) _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) ((p) + (o))))
+
+/* 16 output pixels per step */
+static inline void sobel_row_avx2(const unsigned char* a, const unsigned char* b, const unsigned char* c,
+                                  unsigned char* out, int w, int mode)
+{
+  int x;
+
+  for(x = 1; x + 17 <= w; x += 16) {
+    __m256i a0 = SOBEL_LOAD16(a, x - 1), a1 = SOBEL_LOAD16(a, x), a2 = SOBEL_LOAD16(a, x + 1);
+    __m256i b0 = SOBEL_LOAD16(b, x - 1), b2 = SOBEL_LOAD16(b, x + 1);
+    __m256i c0 = SOBEL_LOAD16(c, x - 1), c1 = SOBEL_LOAD16(c, x), c2 = SOBEL_LOAD16(c, x + 1);
+
+    __m256i d1 = _mm256_sub_epi16(b2, b0);
+    __m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(a2, a0), _mm256_sub_epi16(c2, c0)),
+                                  _mm256_add_epi16(d1, d1));
+    __m256i gy = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(c0, c2), _mm256_add_epi16(c1, c1)),
+                                  _mm256_add_epi16(_mm256_add_epi16(a0, a2), _mm256_add_epi16(a1, a1)));
+    __m256i m;
+
+    if(mode == SOBEL_L1) {
+      m = _mm256_srli_epi16(_mm256_add_epi16(_mm256_abs_epi16(gx), _mm256_abs_epi16(gy)), 2);
+    } else {
+      /* unpack, madd and packs all work per lane, so the order comes back */
+      __m256i lo = _mm256_unpacklo_epi16(gx, gy), hi = _mm256_unpackhi_epi16(gx, gy);
+      __m256i s0 = _mm256_srli_epi32(_mm256_madd_epi16(lo, lo), 4);
+      __m256i s1 = _mm256_srli_epi32(_mm256_madd_epi16(hi, hi), 4);
+      __m256i r0 = _mm256_cvttps_epi32(_mm256_sqrt_ps(_mm256_cvtepi32_ps(s0)));
+      __m256i r1 = _mm256_cvttps_epi32(_mm256_sqrt_ps(_mm256_cvtepi32_ps(s1)));
+      m = _mm256_packs_epi32(r0, r1);
+    }
+    /* packus per lane: pixels 0-7 in quad 0 and 8-15 in quad 2 */
+    m = _mm256_permute4x64_epi64(_mm256_packus_epi16(m, m), 0x08);
+    _mm_storeu_si128((__m128i*) (out + x - 1), _mm256_castsi256_si128(m));
+  }
+  if(x < w - 1) {
+    sobel_row_sse2(a + x - 1, b + x - 1, c + x - 1, out + x - 1, w - x + 1, mode);
+  }
+}
+#endif
+
+/* Best version for the target */
+static inline void sobel_row(const unsigned char* a, const unsigned char* b, const unsigned char* c,
+                             unsigned char* out, int w, int mode)
+{
+#if defined(__AVX2__)
+  sobel_row_avx2(a, b, c, out, w, mode);
+#elif defined(__SSE2__)
+  sobel_row_sse2(a, b, c, out, w, mode);
+#else
+  sobel_row_scalar(a, b, c, out, w, mode);
+#endif
+}
+
+/* Output rows y0 to y1 - 1 of a w x h frame, reading input rows y0 to y1 + 1 */
+static inline void sobel_band(const unsigned char* in, int w, int h, int in_stride,
+                              unsigned char* out, int out_stride, int y0, int y1, int mode)
+{
+  int y;
+  if(y1 > h - 2) {
+    y1 = h - 2;
+  }
+  for(y = y0; y < y1; y++) {
+    sobel_row(in + y * in_stride, in + (y + 1) * in_stride, in + (y + 2) * in_stride,
+              out + y * out_stride, w, mode);
+  }
+}
+
+/* w x h frame to a (w - 2) x (h - 2) frame */
+static inline void sobel(const unsigned char* in, int w, int h, int in_stride,
+                         unsigned char* out, int out_stride, int mode)
+{
+  sobel_band(in, w, h, in_stride, out, out_stride, 0, h - 2, mode);
+}
+
+#endif
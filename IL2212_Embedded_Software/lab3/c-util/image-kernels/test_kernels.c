@@ -0,0 +1,959 @@
+/*
+ * Host check of the image kernels against the reference expressions of
+ * the lab code. Build for the widest SIMD of the machine so every version
+ * is compiled in:
+ *
+ *   gcc -O2 -march=native -pthread -o test_kernels test_kernels.c -lm
+ *   ./test_kernels
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gray.h"
+#include "gray_half.h"
+#include "resize.h"
+#include "sobel.h"
+#include "brightness.h"
+#include "ascii.h"
+#include "pipeline.h"
+#include "tracker.h"
+#include "band_pool.h"
+#include "tiles.h"
+
+typedef void (*gray_fn)(const unsigned char*, unsigned char*, int);
+typedef void (*gray_half_fn)(const unsigned char*, const unsigned char*, unsigned char*, int);
+typedef void (*resize_fn)(const unsigned char*, const unsigned char*, unsigned char*, int);
+typedef void (*sobel_fn)(const unsigned char*, const unsigned char*, const unsigned char*, unsigned char*, int, int);
+typedef void (*brightness_fn)(const unsigned char*, int, unsigned char*, unsigned char*);
+typedef void (*correction_fn)(const unsigned char*, unsigned char*, int, correction_t);
+typedef void (*tracker_fn)(const short*, int*, int*);
+
+static int failures = 0;
+
+static void check(int ok, const char* what)
+{
+  printf("%-40s %s\n", what, ok ? "ok" : "FAILED");
+  if(!ok) {
+    failures++;
+  }
+}
+
+/* Reference of the tasks: double expression truncated to a byte */
+static unsigned char gray_reference(unsigned char r, unsigned char g, unsigned char b)
+{
+  return r * 0.3125 + g * 0.5625 + b * 0.125;
+}
+
+/* All 2^24 colours, one red value (65536 pixels) per call */
+static int gray_exhaustive(gray_fn f)
+{
+  unsigned char* rgb = malloc(3 * 65536);
+  unsigned char* gray = malloc(65536);
+  int r, i, ok = 1;
+
+  for(r = 0; r < 256 && ok; r++) {
+    for(i = 0; i < 65536; i++) {
+      rgb[3 * i] = r;
+      rgb[3 * i + 1] = i >> 8;
+      rgb[3 * i + 2] = i & 0xff;
+    }
+    f(rgb, gray, 65536);
+    for(i = 0; i < 65536; i++) {
+      if(gray[i] != gray_reference(r, i >> 8, i & 0xff)) {
+        printf("  rgb (%d, %d, %d): %d, expected %d\n", r, i >> 8, i & 0xff,
+               gray[i], gray_reference(r, i >> 8, i & 0xff));
+        ok = 0;
+        break;
+      }
+    }
+  }
+
+  free(rgb);
+  free(gray);
+  return ok;
+}
+
+/* Every length up to 100 at every byte offset, nothing written past n */
+static int gray_lengths(gray_fn f)
+{
+  unsigned char rgb[3 * 100 + 16];
+  unsigned char gray[100 + 48];
+  int n, o, i;
+
+  for(i = 0; i < (int) sizeof(rgb); i++) {
+    rgb[i] = rand();
+  }
+  for(n = 0; n <= 100; n++) {
+    for(o = 0; o < 16; o++) {
+      memset(gray, 0xa5, sizeof(gray));
+      f(rgb + o, gray + o, n);
+      for(i = 0; i < n; i++) {
+        const unsigned char* p = rgb + o + 3 * i;
+        if(gray[o + i] != gray_reference(p[0], p[1], p[2])) {
+          return 0;
+        }
+      }
+      for(i = o + n; i < (int) sizeof(gray); i++) {
+        if(gray[i] != 0xa5) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+static void check_gray(gray_fn f, const char* name)
+{
+  char what[64];
+  snprintf(what, sizeof(what), "%s: all 2^24 colours", name);
+  check(gray_exhaustive(f), what);
+  snprintf(what, sizeof(what), "%s: lengths and offsets", name);
+  check(gray_lengths(f), what);
+}
+
+/* Reference of task4: graySDF into a gray frame, then resizeSDF */
+static unsigned char resize_reference(unsigned char a, unsigned char b, unsigned char c, unsigned char d)
+{
+  return (a + b + c + d) / 4.0;
+}
+
+/* Every width up to 200 at every byte offset, nothing written past w / 2 */
+static int gray_half_widths(gray_half_fn f)
+{
+  unsigned char rgb[2][3 * 200 + 16];
+  unsigned char gray[2][200];
+  unsigned char out[100 + 48];
+  int w, o, i;
+
+  for(i = 0; i < (int) sizeof(rgb); i++) {
+    rgb[i & 1][i >> 1] = rand();
+  }
+  for(w = 0; w <= 200; w++) {
+    for(o = 0; o < 16; o++) {
+      gray_convert_scalar(rgb[0] + o, gray[0], w);
+      gray_convert_scalar(rgb[1] + o, gray[1], w);
+      memset(out, 0xa5, sizeof(out));
+      f(rgb[0] + o, rgb[1] + o, out + o, w);
+      for(i = 0; i < w / 2; i++) {
+        if(out[o + i] != resize_reference(gray[0][2 * i], gray[0][2 * i + 1],
+                                          gray[1][2 * i], gray[1][2 * i + 1])) {
+          return 0;
+        }
+      }
+      for(i = o + w / 2; i < (int) sizeof(out); i++) {
+        if(out[i] != 0xa5) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+/* Whole frames with odd sizes and padded strides against gray + resize */
+static int gray_half_frames(void)
+{
+  static unsigned char rgb[67 * 3 * 80];
+  static unsigned char gray[67 * 80];
+  static unsigned char out[40 * 50];
+  int w, h, x, y, i;
+
+  for(i = 0; i < (int) sizeof(rgb); i++) {
+    rgb[i] = rand();
+  }
+  for(w = 60; w <= 67; w++) {
+    for(h = 60; h <= 67; h++) {
+      int rgb_stride = 3 * w + 5, out_stride = w / 2 + 3;
+      for(y = 0; y < h; y++) {
+        gray_convert_scalar(rgb + y * rgb_stride, gray + y * w, w);
+      }
+      gray_half(rgb, w, h, rgb_stride, out, out_stride);
+      for(y = 0; y < h / 2; y++) {
+        for(x = 0; x < w / 2; x++) {
+          const unsigned char* g = gray + 2 * y * w + 2 * x;
+          if(out[y * out_stride + x] != resize_reference(g[0], g[1], g[w], g[w + 1])) {
+            return 0;
+          }
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+static void check_gray_half(gray_half_fn f, const char* name)
+{
+  char what[64];
+  snprintf(what, sizeof(what), "%s: widths and offsets", name);
+  check(gray_half_widths(f), what);
+}
+
+/* Every width up to 200 at every byte offset, nothing written past w / 2 */
+static int resize_widths(resize_fn f)
+{
+  unsigned char in[2][200 + 16];
+  unsigned char out[100 + 48];
+  int w, o, i;
+
+  for(i = 0; i < (int) sizeof(in); i++) {
+    in[i & 1][i >> 1] = rand();
+  }
+  for(w = 0; w <= 200; w++) {
+    for(o = 0; o < 16; o++) {
+      memset(out, 0xa5, sizeof(out));
+      f(in[0] + o, in[1] + o, out + o, w);
+      for(i = 0; i < w / 2; i++) {
+        if(out[o + i] != resize_reference(in[0][o + 2 * i], in[0][o + 2 * i + 1],
+                                          in[1][o + 2 * i], in[1][o + 2 * i + 1])) {
+          return 0;
+        }
+      }
+      for(i = o + w / 2; i < (int) sizeof(out); i++) {
+        if(out[i] != 0xa5) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+/* Frames with odd sizes, padded strides, and in place with out == in */
+static int resize_frames(void)
+{
+  static unsigned char in[140 * 140];
+  static unsigned char frame[140 * 140];
+  static unsigned char out[70 * 80];
+  int w, h, x, y, i, in_place;
+
+  for(i = 0; i < (int) sizeof(in); i++) {
+    in[i] = rand();
+  }
+  for(w = 1; w <= 140; w += 13) {
+    for(h = 1; h <= 140; h += 7) {
+      for(in_place = 0; in_place < 3; in_place++) {
+        int in_stride = in_place ? w : w + 3;
+        /* in place: packed output, or output keeping the input stride */
+        int out_stride = in_place == 2 ? w : w / 2 + (in_place ? 0 : 5);
+        unsigned char* dst = in_place ? frame : out;
+        memcpy(frame, in, sizeof(frame));
+        resize_half(frame, w, h, in_stride, dst, out_stride);
+        for(y = 0; y < h / 2; y++) {
+          for(x = 0; x < w / 2; x++) {
+            const unsigned char* p = in + 2 * y * in_stride + 2 * x;
+            if(dst[y * out_stride + x] != resize_reference(p[0], p[1], p[in_stride], p[in_stride + 1])) {
+              return 0;
+            }
+          }
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+static void check_resize(resize_fn f, const char* name)
+{
+  char what[64];
+  snprintf(what, sizeof(what), "%s: widths and offsets", name);
+  check(resize_widths(f), what);
+}
+
+/* Reference of the byte pipeline: the model's double truncated, clamped */
+static unsigned char sobel_byte(double m)
+{
+  return m >= 255 ? 255 : (unsigned char) m;
+}
+
+/* Every gradient pair against the double magnitude */
+static int sobel_gradients(void)
+{
+  int gx, gy;
+  for(gx = -1020; gx <= 1020; gx++) {
+    for(gy = -1020; gy <= 1020; gy++) {
+      double m = sqrt((double) gx * gx + (double) gy * gy) / 4;
+      unsigned char l1 = sobel_magnitude(gx, gy, SOBEL_L1);
+      if(sobel_magnitude(gx, gy, SOBEL_EXACT) != sobel_byte(m)) {
+        return 0;
+      }
+      if(l1 < sobel_byte(m) || l1 > sobel_byte(m * sqrt(2.0))) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/* Every width up to 100 on random rows and on 0/255 patterns, both modes */
+static int sobel_widths(sobel_fn f)
+{
+  unsigned char in[3][100 + 16];
+  unsigned char out[100 + 32], ref[100];
+  int w, i, k, r, mode;
+
+  for(k = 0; k < 4; k++) {
+    /* random, then the largest gradients in x, in y and diagonal */
+    for(r = 0; r < 3; r++) {
+      for(i = 0; i < (int) sizeof(in[0]); i++) {
+        in[r][i] = k == 0 ? rand() & 0xff :
+                   k == 1 ? (i & 1) * 255 :
+                   k == 2 ? (r == 2) * 255 :
+                            (i + r > 50) * 255;
+      }
+    }
+    for(mode = SOBEL_EXACT; mode <= SOBEL_L1; mode++) {
+      for(w = 3; w <= 100; w++) {
+        sobel_row_scalar(in[0], in[1], in[2], ref, w, mode);
+        memset(out, 0xa5, sizeof(out));
+        f(in[0], in[1], in[2], out, w, mode);
+        if(memcmp(out, ref, w - 2) != 0) {
+          return 0;
+        }
+        for(i = w - 2; i < (int) sizeof(out); i++) {
+          if(out[i] != 0xa5) {
+            return 0;
+          }
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+/* Frames against the model, whole and in bands with padded strides */
+static int sobel_frames(void)
+{
+  static unsigned char in[90 * 90];
+  static unsigned char out[90 * 90];
+  static double ref[90 * 90];
+  int w, h, x, y, y0, band;
+
+  for(x = 0; x < (int) sizeof(in); x++) {
+    in[x] = rand();
+  }
+  for(w = 1; w <= 80; w += 3) {
+    for(h = 1; h <= 80; h += 5) {
+      for(band = 1; band <= 9; band += 4) {
+        int in_stride = w + 7, out_stride = w + 1;
+        sobel_reference(in, w, h, in_stride, ref);
+        memset(out, 0, sizeof(out));
+        for(y0 = 0; y0 < h - 2; y0 += band) {
+          sobel_band(in, w, h, in_stride, out, out_stride, y0, y0 + band, SOBEL_EXACT);
+        }
+        for(y = 0; y < h - 2; y++) {
+          for(x = 0; x < w - 2; x++) {
+            if(out[y * out_stride + x] != sobel_byte(ref[y * (w - 2) + x])) {
+              return 0;
+            }
+          }
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+static void check_sobel(sobel_fn f, const char* name)
+{
+  char what[64];
+  snprintf(what, sizeof(what), "%s: widths, both modes", name);
+  check(sobel_widths(f), what);
+}
+
+/* rescale of the model's correction */
+static double correction_reference(double hmin, double hmax, double h)
+{
+  if(hmax - hmin > 127) return h;
+  if(hmax - hmin > 63) return (h - hmin) * 2;
+  if(hmax - hmin > 31) return (h - hmin) * 4;
+  if(hmax - hmin > 15) return (h - hmin) * 8;
+  return (h - hmin) * 16;
+}
+
+/* Every length up to 100 at every offset against a plain loop */
+static int brightness_lengths(brightness_fn f)
+{
+  unsigned char row[100 + 16];
+  int n, o, i, k;
+
+  for(k = 0; k < 20; k++) {
+    for(i = 0; i < (int) sizeof(row); i++) {
+      row[i] = 64 + rand() % (k + 1);
+    }
+    row[rand() % sizeof(row)] = rand();
+    for(n = 0; n <= 100; n++) {
+      for(o = 0; o < 16; o++) {
+        unsigned char lo = 255, hi = 0, rlo = 255, rhi = 0;
+        f(row + o, n, &lo, &hi);
+        for(i = 0; i < n; i++) {
+          rlo = row[o + i] < rlo ? row[o + i] : rlo;
+          rhi = row[o + i] > rhi ? row[o + i] : rhi;
+        }
+        if(lo != rlo || hi != rhi) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+/* Every (hmin, hmax) and every pixel between them against the model */
+static int correction_buckets(correction_fn f)
+{
+  unsigned char in[256], out[256];
+  int hmin, hmax, i;
+
+  for(hmin = 0; hmin < 256; hmin++) {
+    for(hmax = hmin; hmax < 256; hmax++) {
+      int n = hmax - hmin + 1;
+      for(i = 0; i < n; i++) {
+        in[i] = hmin + i;
+      }
+      f(in, out, n, correction_params(hmin, hmax, 1));
+      for(i = 0; i < n; i++) {
+        if(out[i] != correction_reference(hmin, hmax, in[i])) {
+          return 0;
+        }
+      }
+      f(in, out, n, correction_params(hmin, hmax, 0));
+      if(memcmp(in, out, n) != 0) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/* Any bytes, in or out of range: below hmin gives 0, above the bucket
+   the largest value of the bucket */
+static int correction_any(correction_fn f)
+{
+  unsigned char in[100 + 16], out[100 + 16], ref[100 + 16];
+  int n, k, i;
+
+  for(k = 0; k < 2000; k++) {
+    correction_t p = correction_params(rand() & 0xff, rand() & 0xff, 1);
+    for(i = 0; i < (int) sizeof(in); i++) {
+      in[i] = rand();
+    }
+    n = rand() % 100;
+    for(i = 0; i < n; i++) {
+      int v = in[i] < p.hmin ? 0 : in[i] - p.hmin;
+      ref[i] = (v > 255 >> p.shift ? 255 >> p.shift : v) << p.shift;
+    }
+    memset(out, 0xa5, sizeof(out));
+    f(in, out, n, p);
+    if(memcmp(out, ref, n) != 0 || out[n] != 0xa5) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* control against the mooreSDF of the model on random ranges */
+static int control_sequence(void)
+{
+  double state[3] = {255, 255, 255};
+  control_t c;
+  int n;
+
+  control_init(&c);
+  for(n = 0; n < 10000; n++) {
+    int hmin = rand() & 0xff, hmax = hmin + rand() % (256 - hmin);
+    int model = (state[0] + state[1] + state[2]) / 3 < 128;
+    if(control_enabled(&c) != model) {
+      return 0;
+    }
+    control_update(&c, hmin, hmax);
+    state[2] = state[1];
+    state[1] = state[0];
+    state[0] = hmax - hmin;
+  }
+  return 1;
+}
+
+/* Fused resize and min/max against the two passes */
+static int resize_brightness_frames(void)
+{
+  static unsigned char in[100 * 100], out[50 * 50], ref[50 * 50];
+  int w, h, i;
+
+  for(w = 1; w <= 100; w += 9) {
+    for(h = 1; h <= 100; h += 11) {
+      unsigned char lo, hi, rlo, rhi;
+      for(i = 0; i < w * h; i++) {
+        in[i] = 40 + rand() % (w + 1);
+      }
+      resize_half(in, w, h, w, ref, w / 2);
+      brightness(ref, w / 2, h / 2, w / 2, &rlo, &rhi);
+      resize_brightness(in, w, h, w, out, w / 2, &lo, &hi);
+      if(lo != rlo || hi != rhi || memcmp(out, ref, (w / 2) * (h / 2)) != 0) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+static void check_brightness(brightness_fn b, correction_fn c, const char* name)
+{
+  char what[64];
+  snprintf(what, sizeof(what), "%s: min/max lengths", name);
+  check(brightness_lengths(b), what);
+  snprintf(what, sizeof(what), "%s: correction buckets", name);
+  check(correction_buckets(c), what);
+  snprintf(what, sizeof(what), "%s: correction any input", name);
+  check(correction_any(c), what);
+}
+
+/* printAscii of ascii_gray.h */
+static const char ascii_chars[] = {' ','.',':','-','=','+','/','t','z','U','w','*','0','#','%','@'};
+
+static int ascii_frames(void)
+{
+  static unsigned char img[40 * 30];
+  static char text[30 * 41], ref[30 * 41];
+  char lut[256];
+  int w, h, stride = 40, x, y, n;
+
+  ascii_lut(lut, ascii_chars, 16);
+  for(n = 0; n < 256; n++) {
+    if(lut[n] != ascii_chars[(15 * n) / 255]) {
+      return 0;
+    }
+  }
+  for(n = 0; n < 40 * 30; n++) {
+    img[n] = rand();
+  }
+  for(w = 1; w <= 40; w += 13) {
+    for(h = 1; h <= 30; h += 7) {
+      char* p = ref;
+      for(y = 0; y < h; y++) {
+        for(x = 0; x < w; x++) {
+          *p++ = ascii_chars[(15 * img[y * stride + x]) / 255];
+        }
+        *p++ = '\n';
+      }
+      if(ascii_render(img, w, h, stride, lut, text) != p - ref || memcmp(text, ref, p - ref) != 0) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/* Diff mode: a terminal fed with the output ends up with the frame */
+static int ascii_diff(void)
+{
+  enum { W = 24, H = 10 };
+  static char mem[ASCII_SCREEN_BYTES(W, H)];
+  static unsigned char img[W * H];
+  char term[H][W], ref[H * (W + 1)];
+  ascii_screen_t s;
+  int frame, i, n;
+
+  ascii_screen_init(&s, W, H, ascii_chars, 16, 1, mem);
+  memset(term, '?', sizeof(term));
+  for(frame = 0; frame < 20; frame++) {
+    int line = 0, col = 0, rows = 0;
+    const char* p;
+    for(i = 0; i < (frame ? frame % 4 : W * H); i++) {
+      img[rand() % (W * H)] = rand();
+    }
+    n = ascii_screen_frame(&s, img, W);
+    /* just enough of a terminal: moves, clear and newlines */
+    for(p = s.out; p < s.out + n; p++) {
+      if(*p == '\033') {
+        if(p[2] == 'H' || p[3] == 'J') {
+          p += p[2] == 'H' ? 2 : 3;
+          line = col = 0;
+          continue;
+        }
+        line = strtol(p + 2, (char**) &p, 10) - 1;
+        p += 2;
+        col = 0;
+        rows++;
+      } else if(*p == '\n') {
+        line++;
+        col = 0;
+      } else if(line < H && col < W) {
+        term[line][col++] = *p;
+      } else {
+        return 0;
+      }
+    }
+    ascii_render(img, W, H, W, s.lut, ref);
+    for(i = 0; i < H; i++) {
+      if(memcmp(term[i], ref + i * (W + 1), W) != 0) {
+        return 0;
+      }
+    }
+    /* at most the changed rows and the final move */
+    if(frame && rows > frame % 4 + 1) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Sink that collects the output frame, packed */
+static void pipeline_collect(void* ctx, const unsigned char* row, int y, int w)
+{
+  memcpy((unsigned char*) ctx + y * w, row, w);
+}
+
+/*
+ * Sequences of frames with changing contrast, so that the control turns
+ * the correction on and off, through the stream (by rows and by frames)
+ * and through the frame kernels one after the other.
+ */
+static int pipeline_frames(int mode)
+{
+  enum { W = 45, H = 38 };
+  static unsigned char rgb[W * 3 * H], gray[(W / 2) * (H / 2)];
+  static unsigned char ref[W * H], out[W * H], out2[W * H];
+  static unsigned char mem[PIPELINE_BYTES(W, H, PIPELINE_STORE)];
+  static unsigned char mem2[PIPELINE_BYTES(W, H, PIPELINE_STORE)];
+  const int gw = W / 2, gh = H / 2;
+  pipeline_t rows, frames;
+  control_t c;
+  int last_min = 0, last_max = 255;
+  int frame, i, y;
+
+  pipeline_init(&rows, W, H, mode, SOBEL_EXACT, pipeline_collect, out, mem);
+  pipeline_init(&frames, W, H, mode, SOBEL_EXACT, pipeline_collect, out2, mem2);
+  control_init(&c);
+  for(frame = 0; frame < 24; frame++) {
+    int lo = rand() % 200, span = frame % 8 < 4 ? 255 - lo : 1 + rand() % 60;
+    unsigned char hmin, hmax;
+    for(i = 0; i < W * 3 * H; i++) {
+      rgb[i] = lo + rand() % (span + 1 > 256 - lo ? 256 - lo : span + 1);
+    }
+
+    gray_half(rgb, W, H, 3 * W, gray, gw);
+    brightness(gray, gw, gh, gw, &hmin, &hmax);
+    if(mode == PIPELINE_STORE) {
+      correction(gray, gw, gh, gw, correction_params(hmin, hmax, control_enabled(&c)));
+    } else {
+      correction(gray, gw, gh, gw, correction_params(last_min, last_max, control_enabled(&c)));
+    }
+    sobel(gray, gw, gh, gw, ref, gw - 2, SOBEL_EXACT);
+    control_update(&c, hmin, hmax);
+    last_min = hmin;
+    last_max = hmax;
+
+    for(y = 0; y < H; y++) {
+      pipeline_row(&rows, rgb + y * 3 * W);
+    }
+    pipeline_frame(&frames, rgb, 3 * W);
+    if(memcmp(out, ref, (gw - 2) * (gh - 2)) != 0 || memcmp(out2, ref, (gw - 2) * (gh - 2)) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Tracker.hs on doubles: calcCoord, crop, xcorr2 xPATTERN, posMax, objectPos */
+static void tracker_reference(const unsigned char* rgb, int w, int h, int* px, int* py)
+{
+  static const double pattern[5][5] = {
+    {0, 0, 1, 0, 0}, {0, 1, 0, 1, 0}, {1, 0, 0, 0, 1}, {0, 1, 0, 1, 0}, {0, 0, 1, 0, 0}
+  };
+  int cx, cy, x, y, i, j, bx = 0, by = 0;
+  double best = -1;
+
+  cx = *px <= 15 ? 0 : *px > w - 15 ? w - 32 : *px - 16;
+  cy = *py <= 15 ? 0 : *py > h - 15 ? h - 32 : *py - 16;
+  for(y = 0; y < 27; y++) {
+    for(x = 0; x < 27; x++) {
+      double v = 0;
+      for(i = 0; i < 5; i++) {
+        for(j = 0; j < 5; j++) {
+          const unsigned char* c = rgb + 3 * ((cy + y + i) * w + cx + x + j);
+          v += pattern[i][j] * (c[0] * 0.3125 + c[1] * 0.5625 + c[2] * 0.125);
+        }
+      }
+      if(v > best) {
+        best = v;
+        bx = x;
+        by = y;
+      }
+    }
+  }
+  *px = cx + bx + 2;
+  *py = cy + by + 2;
+}
+
+/* Random windows, with few values so that there are ties, against scalar */
+static int tracker_windows(tracker_fn f)
+{
+  tracker_t t;
+  int k, i, x, y;
+
+  tracker_init(&t);
+  for(k = 0; k < 3000; k++) {
+    int range = k % 3 == 0 ? 2 : k % 3 == 1 ? 50 : 4081;
+    int ox = -1, oy = -1, rx = -2, ry = -2;
+    for(y = 0; y < TRACKER_CROP; y++) {
+      for(i = 0; i < TRACKER_CROP; i++) {
+        t.win[y * TRACKER_STRIDE + i] = rand() % range;
+      }
+    }
+    f(t.win, &ox, &oy);
+    tracker_search_scalar(t.win, &rx, &ry);
+    if(ox != rx || oy != ry) {
+      return 0;
+    }
+  }
+  /* all equal: the first output */
+  for(y = 0; y < TRACKER_CROP; y++) {
+    for(x = 0; x < TRACKER_CROP; x++) {
+      t.win[y * TRACKER_STRIDE + x] = 4080;
+    }
+  }
+  f(t.win, &x, &y);
+  return x == 0 && y == 0;
+}
+
+/* An X shaped object moving over noise, fed by rows next to a pipeline
+   and by frames, against the model with its delay feedback */
+static int tracker_sequence(void)
+{
+  enum { W = 80, H = 60 };
+  static unsigned char rgb[W * 3 * H], out[W * H];
+  static unsigned char mem[PIPELINE_BYTES(W, H, PIPELINE_DELAYED)];
+  static const int dx[8] = {2, 1, 3, 0, 4, 1, 3, 2}, dy[8] = {0, 1, 1, 2, 2, 3, 3, 4};
+  tracker_t rows, frames;
+  pipeline_t p;
+  int px = 15, py = 15, ox = 20, oy = 17;
+  int frame, i, y;
+
+  tracker_init(&rows);
+  tracker_init(&frames);
+  pipeline_init(&p, W, H, PIPELINE_DELAYED, SOBEL_EXACT, pipeline_collect, out, mem);
+  p.tracker = &rows;
+  for(frame = 0; frame < 300; frame++) {
+    for(i = 0; i < W * 3 * H; i++) {
+      rgb[i] = rand() % (frame % 5 == 4 ? 256 : 60);
+    }
+    /* drift by up to 5 pixels, so the object stays in the window */
+    ox += rand() % 11 - 5;
+    oy += rand() % 11 - 5;
+    ox = ox < 0 ? 0 : ox > W - 5 ? W - 5 : ox;
+    oy = oy < 0 ? 0 : oy > H - 5 ? H - 5 : oy;
+    for(i = 0; i < 8; i++) {
+      unsigned char* c = rgb + 3 * ((oy + dy[i]) * W + ox + dx[i]);
+      c[0] = c[1] = c[2] = 200 + rand() % 56;
+    }
+
+    tracker_reference(rgb, W, H, &px, &py);
+    for(y = 0; y < H; y++) {
+      pipeline_row(&p, rgb + y * 3 * W);
+    }
+    tracker_frame(&frames, rgb, W, H, 3 * W);
+    if(rows.x != px || rows.y != py || frames.x != px || frames.y != py) {
+      printf("  frame %d: (%d, %d) and (%d, %d), expected (%d, %d)\n",
+             frame, rows.x, rows.y, frames.x, frames.y, px, py);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Every stage on pools of several sizes against the serial kernels */
+static int band_frames(int threads)
+{
+  enum { W = 203, H = 157, GW = W / 2, GH = H / 2 };
+  static unsigned char rgb[W * 3 * H], gray[W * H], ref[W * H], out[W * H];
+  static char text[(W + 1) * H], text_ref[(W + 1) * H];
+  static unsigned char half[GW * GH], sob[GW * GH], sob_ref[GW * GH];
+  static unsigned char mem[PIPELINE_BYTES(W, H, PIPELINE_STORE)];
+  band_pool_t pool;
+  pipeline_t pipe;
+  control_t c;
+  char lut[256];
+  int i, frame, ok = 1;
+
+  band_pool_init(&pool, threads);
+  for(i = 0; i < W * 3 * H; i++) {
+    rgb[i] = rand();
+  }
+  gray_convert(rgb, ref, W * H);
+  band_gray(&pool, rgb, W, H, 3 * W, out, W);
+  ok &= memcmp(out, ref, W * H) == 0;
+  memcpy(gray, ref, W * H);
+
+  resize_half(gray, W, H, W, ref, GW);
+  band_resize_half(&pool, gray, W, H, W, out, GW);
+  ok &= memcmp(out, ref, GW * GH) == 0;
+
+  sobel(gray, W, H, W, ref, W - 2, SOBEL_EXACT);
+  band_sobel(&pool, gray, W, H, W, out, W - 2, SOBEL_EXACT);
+  ok &= memcmp(out, ref, (W - 2) * (H - 2)) == 0;
+
+  ascii_lut(lut, ascii_chars, 16);
+  ascii_render(gray, W, H, W, lut, text_ref);
+  ok &= band_ascii(&pool, gray, W, H, W, lut, text) == (W + 1) * H;
+  ok &= memcmp(text, text_ref, (W + 1) * H) == 0;
+
+  /* the whole chain, with contrast changes for the control */
+  pipeline_init(&pipe, W, H, PIPELINE_STORE, SOBEL_L1, pipeline_collect, sob_ref, mem);
+  control_init(&c);
+  for(frame = 0; frame < 12 && ok; frame++) {
+    int lo = rand() % 128, span = frame % 6 < 3 ? 255 - lo : 1 + rand() % 40;
+    for(i = 0; i < W * 3 * H; i++) {
+      rgb[i] = lo + rand() % (span + 1);
+    }
+    pipeline_frame(&pipe, rgb, 3 * W);
+    ok &= band_process(&pool, &c, rgb, W, H, 3 * W, sob, GW - 2, half, SOBEL_L1) == 0;
+    ok &= memcmp(sob, sob_ref, (GW - 2) * (GH - 2)) == 0;
+  }
+  band_pool_destroy(&pool);
+  return ok;
+}
+
+/* A sequence with small changes: the cached outputs of every stage
+   against the whole frame done again */
+static int tiles_sequence(void)
+{
+  enum { W = 101, H = 75, W2 = W / 2, H2 = H / 2, W4 = W / 4, H4 = H / 4 };
+  static unsigned char mem[TILES_BYTES(W, H)];
+  static unsigned char rgb[W * 3 * H];
+  static unsigned char gray[W * H], half[W2 * H2], quarter[W4 * H4], sob[W2 * H2];
+  static unsigned char ref[W * H], ref2[W2 * H2];
+  static char text[(W4 + 1) * H4], text_ref[(W4 + 1) * H4];
+  tiles_t t;
+  char lut[256];
+  int frame, i, k, n;
+
+  tiles_init(&t, W, H, mem);
+  ascii_lut(lut, ascii_chars, 16);
+  for(i = 0; i < W * 3 * H; i++) {
+    rgb[i] = rand();
+  }
+  for(frame = 0; frame < 40; frame++) {
+    int changes = frame % 10 == 9 ? 0 : 1 + rand() % 5;
+    for(k = 0; k < changes; k++) {
+      /* a small block somewhere, borders included */
+      int bx = rand() % W, by = rand() % H, x, y;
+      for(y = by; y < by + 3 && y < H; y++) {
+        for(x = 3 * bx; x < 3 * (bx + 3) && x < 3 * W; x++) {
+          rgb[y * 3 * W + x] = rand();
+        }
+      }
+    }
+    n = tiles_update(&t, rgb, 3 * W);
+    if(frame > 0 && n > 4 * changes) {
+      return 0;
+    }
+    tiles_gray(&t, rgb, 3 * W, gray, W);
+    tiles_gray_half(&t, rgb, 3 * W, half, W2);
+    tiles_resize_half(&t, 2, half, W2, quarter, W4);
+    tiles_ascii(&t, 4, quarter, W4, lut, text);
+    tiles_sobel(&t, 2, half, W2, sob, W2 - 2, SOBEL_EXACT);
+
+    gray_convert(rgb, ref, W * H);
+    if(memcmp(gray, ref, W * H) != 0) {
+      return 0;
+    }
+    gray_half(rgb, W, H, 3 * W, ref2, W2);
+    if(memcmp(half, ref2, W2 * H2) != 0) {
+      return 0;
+    }
+    resize_half(ref2, W2, H2, W2, ref, W4);
+    if(memcmp(quarter, ref, W4 * H4) != 0) {
+      return 0;
+    }
+    ascii_render(ref, W4, H4, W4, lut, text_ref);
+    if(memcmp(text, text_ref, (W4 + 1) * H4) != 0) {
+      return 0;
+    }
+    sobel(ref2, W2, H2, W2, ref, W2 - 2, SOBEL_EXACT);
+    if(memcmp(sob, ref, (W2 - 2) * (H2 - 2)) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int main(void)
+{
+  check_gray(gray_convert_scalar, "gray scalar");
+#if defined(__SSSE3__) || defined(__AVX2__)
+  check_gray(gray_convert_ssse3, "gray ssse3");
+#endif
+#if defined(__AVX2__)
+  check_gray(gray_convert_avx2, "gray avx2");
+#endif
+
+  check_gray_half(gray_half_row_scalar, "gray_half scalar");
+#if defined(__SSSE3__) || defined(__AVX2__)
+  check_gray_half(gray_half_row_ssse3, "gray_half ssse3");
+#endif
+#if defined(__AVX2__)
+  check_gray_half(gray_half_row_avx2, "gray_half avx2");
+#endif
+  check(gray_half_frames(), "gray_half: frames and strides");
+
+  check_resize(resize_row_scalar, "resize scalar");
+#if defined(__SSE2__) || defined(__AVX2__)
+  check_resize(resize_row_sse2, "resize sse2");
+#endif
+#if defined(__AVX2__)
+  check_resize(resize_row_avx2, "resize avx2");
+#endif
+  check(resize_frames(), "resize: frames, strides and in place");
+
+  check(sobel_gradients(), "sobel: all gradients, exact and L1");
+  check_sobel(sobel_row_scalar, "sobel scalar");
+#if defined(__SSE2__) || defined(__AVX2__)
+  check_sobel(sobel_row_sse2, "sobel sse2");
+#endif
+#if defined(__AVX2__)
+  check_sobel(sobel_row_avx2, "sobel avx2");
+#endif
+  check(sobel_frames(), "sobel: frames and bands against model");
+
+  check_brightness(brightness_row_scalar, correction_row_scalar, "brightness scalar");
+#if defined(__SSE2__) || defined(__AVX2__)
+  check_brightness(brightness_row_sse2, correction_row_sse2, "brightness sse2");
+#endif
+#if defined(__AVX2__)
+  check_brightness(brightness_row_avx2, correction_row_avx2, "brightness avx2");
+#endif
+  check(resize_brightness_frames(), "resize_brightness: against two passes");
+  check(control_sequence(), "control: against the model");
+
+  check(ascii_frames(), "ascii: table and frames");
+  check(ascii_diff(), "ascii: diff mode");
+
+  check(pipeline_frames(PIPELINE_STORE), "pipeline: frame store against kernels");
+  check(pipeline_frames(PIPELINE_DELAYED), "pipeline: delayed min/max against kernels");
+
+  check(tracker_windows(tracker_search_scalar), "tracker scalar: windows and ties");
+#if defined(__SSE2__) || defined(__AVX2__)
+  check(tracker_windows(tracker_search_sse2), "tracker sse2: windows against scalar");
+#endif
+#if defined(__AVX2__)
+  check(tracker_windows(tracker_search_avx2), "tracker avx2: windows against scalar");
+#endif
+  check(tracker_sequence(), "tracker: sequence against the model");
+
+  check(band_frames(1), "band_pool 1 thread: against serial");
+  check(band_frames(3), "band_pool 3 threads: against serial");
+  check(band_frames(8), "band_pool 8 threads: against serial");
+
+  check(tiles_sequence(), "tiles: cached stages against full frames");
+
+  if(failures) {
+    printf("%d checks FAILED\n", failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
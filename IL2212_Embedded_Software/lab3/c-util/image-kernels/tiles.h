@@ -0,0 +1,206 @@
+#ifndef TILES_H
+#define TILES_H
+
+/*
+ * Incremental processing of sequences where only small parts of the frame
+ * change from one frame to the next.
+ *
+ * The RGB frame is cut into TILE x TILE tiles. tiles_update compares every
+ * tile with the same tile of the previous frame, marks it dirty if any
+ * byte differs and keeps a copy of it for the next frame. The compare is
+ * exact (memcmp, no hash), so the outputs are always the same as
+ * processing the whole frame. The first frame is dirty everywhere.
+ *
+ * The tiles_* stages then only redo the dirty tiles of their output and
+ * leave the rest of the output frame as it was, which is the cached
+ * result of the earlier frames. Stages that halve the frame work on the
+ * same tiles at scale 2 (8 x 8) or 4 (4 x 4); TILE is a multiple of 4 so
+ * the tiles of every stage cover the same input pixels.
+ *
+ * gray, resize and the ASCII render only read their own tile. sobel
+ * reads 2 rows and columns past it: output pixel (x, y) depends on input
+ * pixels x to x + 2 and y to y + 2, so a dirty tile dirties the outputs
+ * from 2 rows and columns before it (tiles_sobel). correction depends on
+ * the min and max of the whole frame: when its parameters change, call
+ * tiles_mark_all before the stages after it.
+ */
+
+#include <string.h>
+
+#include "gray.h"
+#include "gray_half.h"
+#include "resize.h"
+#include "sobel.h"
+#include "ascii.h"
+
+#define TILE 16
+
+typedef struct {
+  int w, h;               /* RGB frame */
+  int tx, ty;             /* tiles across and down */
+  int valid;              /* prev holds the last frame */
+  unsigned char* prev;    /* last frame, 3 * w bytes per row */
+  unsigned char* dirty;   /* one flag per tile, row by row */
+} tiles_t;
+
+/* Memory tiles_init needs for w x h frames */
+#define TILES_BYTES(w, h) \
+  (3 * (w) * (h) + (((w) + TILE - 1) / TILE) * (((h) + TILE - 1) / TILE))
+
+/* mem holds TILES_BYTES(w, h) bytes and stays owned by the caller */
+static inline void tiles_init(tiles_t* t, int w, int h, void* mem)
+{
+  t->w = w;
+  t->h = h;
+  t->tx = (w + TILE - 1) / TILE;
+  t->ty = (h + TILE - 1) / TILE;
+  t->valid = 0;
+  t->prev = (unsigned char*) mem;
+  t->dirty = t->prev + 3 * w * h;
+}
+
+/* Every tile dirty, for this frame */
+static inline void tiles_mark_all(tiles_t* t)
+{
+  memset(t->dirty, 1, t->tx * t->ty);
+}
+
+/* Mark the tiles that differ from the last frame; returns how many */
+static inline int tiles_update(tiles_t* t, const unsigned char* rgb, int stride)
+{
+  int i, j, y, n = 0;
+  for(j = 0; j < t->ty; j++) {
+    int y0 = j * TILE, y1 = y0 + TILE < t->h ? y0 + TILE : t->h;
+    for(i = 0; i < t->tx; i++) {
+      int x0 = 3 * i * TILE, bytes = 3 * (i * TILE + TILE < t->w ? TILE : t->w - i * TILE);
+      int d = !t->valid;
+      for(y = y0; y < y1; y++) {
+        unsigned char* p = t->prev + y * 3 * t->w + x0;
+        const unsigned char* q = rgb + y * stride + x0;
+        /* rows before the first difference are already equal */
+        if(d || memcmp(p, q, bytes) != 0) {
+          d = 1;
+          memcpy(p, q, bytes);
+        }
+      }
+      t->dirty[j * t->tx + i] = d;
+      n += d;
+    }
+  }
+  t->valid = 1;
+  return n;
+}
+
+/* Tile (i, j) in a frame at 1 / s of the RGB frame: x0 to x1 - 1, y0 to y1 - 1 */
+static inline void tiles_rect(const tiles_t* t, int i, int j, int s, int* x0, int* y0, int* x1, int* y1)
+{
+  int ws = t->w / s, hs = t->h / s;
+  *x0 = i * TILE / s;
+  *y0 = j * TILE / s;
+  *x1 = (i + 1) * TILE / s < ws ? (i + 1) * TILE / s : ws;
+  *y1 = (j + 1) * TILE / s < hs ? (j + 1) * TILE / s : hs;
+}
+
+/* gray_convert of the dirty tiles, out is w x h */
+static inline void tiles_gray(const tiles_t* t, const unsigned char* rgb, int stride,
+                              unsigned char* out, int out_stride)
+{
+  int i, j, x0, y0, x1, y1, y;
+  for(j = 0; j < t->ty; j++) {
+    for(i = 0; i < t->tx; i++) {
+      if(!t->dirty[j * t->tx + i]) {
+        continue;
+      }
+      tiles_rect(t, i, j, 1, &x0, &y0, &x1, &y1);
+      for(y = y0; y < y1; y++) {
+        gray_convert(rgb + y * stride + 3 * x0, out + y * out_stride + x0, x1 - x0);
+      }
+    }
+  }
+}
+
+/* gray_half of the dirty tiles, out is (w / 2) x (h / 2) */
+static inline void tiles_gray_half(const tiles_t* t, const unsigned char* rgb, int stride,
+                                   unsigned char* out, int out_stride)
+{
+  int i, j, x0, y0, x1, y1, y;
+  for(j = 0; j < t->ty; j++) {
+    for(i = 0; i < t->tx; i++) {
+      if(!t->dirty[j * t->tx + i]) {
+        continue;
+      }
+      tiles_rect(t, i, j, 2, &x0, &y0, &x1, &y1);
+      for(y = y0; y < y1; y++) {
+        gray_half_row(rgb + 2 * y * stride + 6 * x0, rgb + (2 * y + 1) * stride + 6 * x0,
+                      out + y * out_stride + x0, 2 * (x1 - x0));
+      }
+    }
+  }
+}
+
+/* resize_half of the dirty tiles of a frame at scale s (1 or 2) to scale 2 * s */
+static inline void tiles_resize_half(const tiles_t* t, int s, const unsigned char* in, int in_stride,
+                                     unsigned char* out, int out_stride)
+{
+  int i, j, x0, y0, x1, y1, y;
+  for(j = 0; j < t->ty; j++) {
+    for(i = 0; i < t->tx; i++) {
+      if(!t->dirty[j * t->tx + i]) {
+        continue;
+      }
+      tiles_rect(t, i, j, 2 * s, &x0, &y0, &x1, &y1);
+      for(y = y0; y < y1; y++) {
+        resize_row(in + 2 * y * in_stride + 2 * x0, in + (2 * y + 1) * in_stride + 2 * x0,
+                   out + y * out_stride + x0, 2 * (x1 - x0));
+      }
+    }
+  }
+}
+
+/* ascii_render of the dirty tiles of a frame at scale s into text, which
+   has (w / s + 1) bytes per row like ascii_render writes them */
+static inline void tiles_ascii(const tiles_t* t, int s, const unsigned char* img, int stride,
+                               const char* lut, char* text)
+{
+  int ws = t->w / s, i, j, x0, y0, x1, y1, y;
+  for(j = 0; j < t->ty; j++) {
+    for(i = 0; i < t->tx; i++) {
+      if(!t->dirty[j * t->tx + i]) {
+        continue;
+      }
+      tiles_rect(t, i, j, s, &x0, &y0, &x1, &y1);
+      for(y = y0; y < y1; y++) {
+        char* end = ascii_row(img + y * stride + x0, x1 - x0, lut, text + y * (ws + 1) + x0);
+        if(x1 == ws) {
+          *end = '\n';
+        }
+      }
+    }
+  }
+}
+
+/* sobel of a frame at scale s, for the outputs the dirty tiles reach */
+static inline void tiles_sobel(const tiles_t* t, int s, const unsigned char* in, int in_stride,
+                               unsigned char* out, int out_stride, int mode)
+{
+  int ws = t->w / s, hs = t->h / s, i, j, x0, y0, x1, y1, y;
+  for(j = 0; j < t->ty; j++) {
+    for(i = 0; i < t->tx; i++) {
+      if(!t->dirty[j * t->tx + i]) {
+        continue;
+      }
+      tiles_rect(t, i, j, s, &x0, &y0, &x1, &y1);
+      /* outputs x0 - 2 to x1 - 1, within the (ws - 2) x (hs - 2) frame */
+      x0 = x0 < 2 ? 0 : x0 - 2;
+      y0 = y0 < 2 ? 0 : y0 - 2;
+      x1 = x1 < ws - 2 ? x1 : ws - 2;
+      y1 = y1 < hs - 2 ? y1 : hs - 2;
+      for(y = y0; y < y1 && x0 < x1; y++) {
+        sobel_row(in + y * in_stride + x0, in + (y + 1) * in_stride + x0, in + (y + 2) * in_stride + x0,
+                  out + y * out_stride + x0, x1 - x0 + 2, mode);
+      }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,246 @@
+#ifndef TRACKER_H
+#define TRACKER_H
+
+/*
+ * Object tracker of the model (src-old/Tracker.hs): crop a 31 x 31 window
+ * from the gray frame at calcCoord of the previous position, correlate it
+ * with the 5 x 5 xPATTERN, take the first maximum (posMax) and add the
+ * crop origin and the centre of the pattern (objectPos). The position is
+ * fed back to the next frame like delaySDF, starting from (15, 15).
+ *
+ * The model's gray is not truncated. Its coefficients are 5/16, 9/16 and
+ * 2/16, so 16 * gray = 5r + 9g + 2b is an exact integer of at most 4080,
+ * and comparing sums of those compares the model's doubles exactly. Only
+ * the window is converted, 961 pixels per frame.
+ *
+ * xPATTERN has 8 taps, all 1, so every correlation output is 8 adds. With
+ * 8 * 4080 < 2^15 they fit 16 bit lanes: SSE2 does 8 outputs per add and
+ * AVX2 16. The window rows are padded with zeros up to TRACKER_STRIDE so a
+ * row of 27 outputs is 4 (or 2) whole vectors. The arg max is fused: the
+ * maximum of every row is folded in registers, and only a row that beats
+ * the best so far is searched for the first lane with that value, which
+ * gives the row-major first maximum of posMax.
+ *
+ * The window only needs rows cy to cy + 30, so the tracker takes the
+ * frame as a stream of RGB rows (tracker_row) next to pipeline.h, or from
+ * memory (tracker_frame). Frames are at least 32 x 32.
+ */
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define TRACKER_SPAN   15
+#define TRACKER_CROP   (2 * TRACKER_SPAN + 1)
+#define TRACKER_OUT    (TRACKER_CROP - 4)
+/* 32 outputs and the 4 columns right of them, rounded up */
+#define TRACKER_STRIDE 40
+
+typedef struct {
+  int x, y;       /* last position, the delaySDF token */
+  int cx, cy;     /* crop origin of the current frame */
+  short win[TRACKER_CROP * TRACKER_STRIDE];
+} tracker_t;
+
+/* -1 for the 27 outputs of a row, 0 for the padding lanes */
+static const short tracker_valid[32] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  0,  0,  0,  0
+};
+
+static inline void tracker_init(tracker_t* t)
+{
+  t->x = TRACKER_SPAN;
+  t->y = TRACKER_SPAN;
+  t->cx = t->cy = 0;
+  memset(t->win, 0, sizeof(t->win));
+}
+
+/* calcCoord: crop origin for a w x h frame from the last position */
+static inline void tracker_begin(tracker_t* t, int w, int h)
+{
+  if(t->x <= TRACKER_SPAN) {
+    t->cx = 0;
+  } else if(t->x > w - TRACKER_SPAN) {
+    t->cx = w - TRACKER_CROP - 1;
+  } else {
+    t->cx = t->x - TRACKER_SPAN - 1;
+  }
+  if(t->y <= TRACKER_SPAN) {
+    t->cy = 0;
+  } else if(t->y > h - TRACKER_SPAN) {
+    t->cy = h - TRACKER_CROP - 1;
+  } else {
+    t->cy = t->y - TRACKER_SPAN - 1;
+  }
+}
+
+/* Output x of window row a: the 8 taps of xPATTERN */
+#define TRACKER_XCORR(a, x) \
+  ((a)[(x) + 2] + \
+   (a)[TRACKER_STRIDE + (x) + 1] + (a)[TRACKER_STRIDE + (x) + 3] + \
+   (a)[2 * TRACKER_STRIDE + (x)] + (a)[2 * TRACKER_STRIDE + (x) + 4] + \
+   (a)[3 * TRACKER_STRIDE + (x) + 1] + (a)[3 * TRACKER_STRIDE + (x) + 3] + \
+   (a)[4 * TRACKER_STRIDE + (x) + 2])
+
+/* xcorr2 and posMax over the window: offset of the first maximum */
+static inline void tracker_search_scalar(const short* win, int* ox, int* oy)
+{
+  int best = -1, x, y;
+  for(y = 0; y < TRACKER_OUT; y++) {
+    const short* a = win + y * TRACKER_STRIDE;
+    for(x = 0; x < TRACKER_OUT; x++) {
+      int v = TRACKER_XCORR(a, x);
+      if(v > best) {
+        best = v;
+        *ox = x;
+        *oy = y;
+      }
+    }
+  }
+}
+
+/* First output of a row equal to its maximum m */
+static inline int tracker_first(const short* row, int m)
+{
+  int x = 0;
+  while(row[x] != m) {
+    x++;
+  }
+  return x;
+}
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#define TRACKER_LOAD8(a, o) _mm_loadu_si128((const __m128i*) ((a) + (o)))
+
+static inline int tracker_hmax_sse2(__m128i m)
+{
+  m = _mm_max_epi16(m, _mm_srli_si128(m, 8));
+  m = _mm_max_epi16(m, _mm_srli_si128(m, 4));
+  m = _mm_max_epi16(m, _mm_srli_si128(m, 2));
+  return (short) _mm_cvtsi128_si32(m);
+}
+
+/* 8 outputs per add, 4 vectors per row */
+static inline void tracker_search_sse2(const short* win, int* ox, int* oy)
+{
+  short row[32];
+  int best = -1, x, y;
+  for(y = 0; y < TRACKER_OUT; y++) {
+    const short* a = win + y * TRACKER_STRIDE;
+    __m128i m = _mm_setzero_si128();
+    int rmax;
+    for(x = 0; x < 32; x += 8) {
+      __m128i v = _mm_add_epi16(
+        _mm_add_epi16(_mm_add_epi16(TRACKER_LOAD8(a, x + 2),
+                                    TRACKER_LOAD8(a, TRACKER_STRIDE + x + 1)),
+                      _mm_add_epi16(TRACKER_LOAD8(a, TRACKER_STRIDE + x + 3),
+                                    TRACKER_LOAD8(a, 2 * TRACKER_STRIDE + x))),
+        _mm_add_epi16(_mm_add_epi16(TRACKER_LOAD8(a, 2 * TRACKER_STRIDE + x + 4),
+                                    TRACKER_LOAD8(a, 3 * TRACKER_STRIDE + x + 1)),
+                      _mm_add_epi16(TRACKER_LOAD8(a, 3 * TRACKER_STRIDE + x + 3),
+                                    TRACKER_LOAD8(a, 4 * TRACKER_STRIDE + x + 2))));
+      _mm_storeu_si128((__m128i*) (row + x), v);
+      /* outputs are >= 0, so a cleared padding lane never wins */
+      m = _mm_max_epi16(m, _mm_and_si128(v, TRACKER_LOAD8(tracker_valid, x)));
+    }
+    rmax = tracker_hmax_sse2(m);
+    if(rmax > best) {
+      best = rmax;
+      *ox = tracker_first(row, rmax);
+      *oy = y;
+    }
+  }
+}
+#endif
+
+#if defined(__AVX2__)
+#define TRACKER_LOAD16(a, o) _mm256_loadu_si256((const __m256i*) ((a) + (o)))
+
+/* 16 outputs per add, 2 vectors per row */
+static inline void tracker_search_avx2(const short* win, int* ox, int* oy)
+{
+  short row[32];
+  int best = -1, x, y;
+  for(y = 0; y < TRACKER_OUT; y++) {
+    const short* a = win + y * TRACKER_STRIDE;
+    __m256i m = _mm256_setzero_si256();
+    int rmax;
+    for(x = 0; x < 32; x += 16) {
+      __m256i v = _mm256_add_epi16(
+        _mm256_add_epi16(_mm256_add_epi16(TRACKER_LOAD16(a, x + 2),
+                                          TRACKER_LOAD16(a, TRACKER_STRIDE + x + 1)),
+                         _mm256_add_epi16(TRACKER_LOAD16(a, TRACKER_STRIDE + x + 3),
+                                          TRACKER_LOAD16(a, 2 * TRACKER_STRIDE + x))),
+        _mm256_add_epi16(_mm256_add_epi16(TRACKER_LOAD16(a, 2 * TRACKER_STRIDE + x + 4),
+                                          TRACKER_LOAD16(a, 3 * TRACKER_STRIDE + x + 1)),
+                         _mm256_add_epi16(TRACKER_LOAD16(a, 3 * TRACKER_STRIDE + x + 3),
+                                          TRACKER_LOAD16(a, 4 * TRACKER_STRIDE + x + 2))));
+      _mm256_storeu_si256((__m256i*) (row + x), v);
+      m = _mm256_max_epi16(m, _mm256_and_si256(v, TRACKER_LOAD16(tracker_valid, x)));
+    }
+    rmax = tracker_hmax_sse2(_mm_max_epi16(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1)));
+    if(rmax > best) {
+      best = rmax;
+      *ox = tracker_first(row, rmax);
+      *oy = y;
+    }
+  }
+}
+#endif
+
+/* Best version for the target */
+static inline void tracker_search(const short* win, int* ox, int* oy)
+{
+#if defined(__AVX2__)
+  tracker_search_avx2(win, ox, oy);
+#elif defined(__SSE2__)
+  tracker_search_sse2(win, ox, oy);
+#else
+  tracker_search_scalar(win, ox, oy);
+#endif
+}
+
+/* objectPos from the window, which becomes the position of the next frame */
+static inline void tracker_end(tracker_t* t)
+{
+  int ox = 0, oy = 0;
+  tracker_search(t->win, &ox, &oy);
+  t->x = t->cx + ox + 2;
+  t->y = t->cy + oy + 2;
+}
+
+/* Row y of the RGB frame; the search runs when the last window row is in */
+static inline void tracker_row(tracker_t* t, const unsigned char* rgb, int y)
+{
+  short* dst;
+  int x;
+  if(y < t->cy || y >= t->cy + TRACKER_CROP) {
+    return;
+  }
+  dst = t->win + (y - t->cy) * TRACKER_STRIDE;
+  rgb += 3 * t->cx;
+  for(x = 0; x < TRACKER_CROP; x++) {
+    dst[x] = 5 * rgb[0] + 9 * rgb[1] + 2 * rgb[2];
+    rgb += 3;
+  }
+  if(y == t->cy + TRACKER_CROP - 1) {
+    tracker_end(t);
+  }
+}
+
+/* Position of the object in a w x h RGB frame in memory, in t->x and t->y */
+static inline void tracker_frame(tracker_t* t, const unsigned char* rgb, int w, int h, int stride)
+{
+  int y;
+  tracker_begin(t, w, h);
+  for(y = t->cy; y < t->cy + TRACKER_CROP; y++) {
+    tracker_row(t, rgb + y * stride, y);
+  }
+}
+
+#endif
@@ -1,128 +1,698 @@
 #include "ppm_io.h"
 
-int write_buf(char* buffer, char c, int* buf_len, int count){
-  if(count == *buf_len){
-    *buf_len += BUF_LEN;
-    buffer = (char*) realloc(buffer, *buf_len);
-  }
-  buffer[count] = c;
-}
-
-char* read_word(FILE *fp){
-  enum { S1, S2, S3 } state = S1;
-
-  int buf_len = BUF_LEN;
-  int count = 0;
-  char *buffer = malloc(sizeof(char) * buf_len);
-  char c;
-  
-  while((c = fgetc(fp)) != EOF){
-    switch(state){
-    //init state
-    case S1:
-      if(isspace(c)) continue;
-      else if(c != '#'){
-	state = S2;
-	write_buf(buffer, c, &buf_len, count);
-	count += 1;
-	continue;
-      }
-      else {state = S3; continue;}
-    //read in state
-    case S2:
-      if(!isspace(c) && (c != '#')){
-	write_buf(buffer, c, &buf_len, count);
-	buffer[count] = c;
-	count += 1;
-	continue;
-      }
-      else if(c == '#') {state = S3; continue;}
-      else break;
-    //comment state
-    case S3:
-      if(c != '\n') continue;
-      else break;
+#include <limits.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char* ppm_messages[] = {
+  "",
+  "cannot open the file",
+  "The file is not a PPM file.",
+  "Width of the image is not valid.",
+  "Height of the image is not valid.",
+  "Max value of the image is not valid.",
+  "Pixel value overflow",
+  "Number of pixels is not equal with the specified dimention.",
+  "Out of memory",
+  "Samples do not fit the storage."
+};
+
+const char* ppm_error(int err){
+  if(err < 0 || err >= (int) (sizeof(ppm_messages) / sizeof(ppm_messages[0]))) return "";
+  return ppm_messages[err];
+}
+
+/* PPM whitespace, without the locale lookups of isspace */
+#define PPM_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+/* Skip whitespace and # comments up to the next token */
+static const char* skip_space(const char* p, const char* end){
+  while(p < end){
+    if(PPM_SPACE(*p)) p++;
+    else if(*p == '#'){
+      while(p < end && *p != '\n') p++;
     }
-    break;
-  } 
+    else break;
+  }
+  return p;
+}
 
-  if(count == buf_len){
-    buf_len += 1;
-    buffer = (char*) realloc(buffer, buf_len);
+/* Next token as an unsigned decimal, -1 if it is not one */
+static int read_number(const char** pos, const char* end){
+  const char* p = skip_space(*pos, end);
+  const char* start = p;
+  int v = 0;
+  while(p < end && (unsigned) (*p - '0') < 10){
+    if(v > (INT_MAX - 9) / 10) return -1;
+    v = v * 10 + (*p - '0');
+    p++;
   }
-  buffer[count] = '\0';
-  
-  return buffer;
+  if(p == start || (p < end && !PPM_SPACE(*p) && *p != '#')) return -1;
+  *pos = p;
+  return v;
 }
 
-ppmTy ppm_read(char *file_name){
-  FILE *ppm_file = fopen(file_name, "r");
-  ppmTy ppm_data;
-  char* word;
-  enum { READ_HEAD, READ_WIDTH, READ_HEIGHT, READ_MAX_V, READ_PIXEL} state = READ_HEAD;
-  int count = 0;
-  if(ppm_file != NULL){
-    do{
-      word = read_word(ppm_file);
-      
-      switch(state){
-      case READ_HEAD:
-	if(strcmp(word, "P3") == 0) {state = READ_WIDTH; continue;}
-	printf("The file is not a PPM file.%s \n", word);
-	exit(1);
-      case READ_WIDTH:
-	ppm_data.w = atoi(word);
-	if(ppm_data.w != 0) {state = READ_HEIGHT; continue;}
-	printf("Width of the image is not valid.\n");
-	exit(1);
-      case READ_HEIGHT:
-	ppm_data.h = atoi(word);
-	if(ppm_data.h != 0) {
-	  ppm_data.data = malloc(sizeof(unsigned int) * ppm_data.w * ppm_data.h * 3);
-	  state = READ_MAX_V;
-	  continue;}
-	printf("Height of the image is not valid.\n");
-	exit(1);
-      case READ_MAX_V:
-	ppm_data.max_val = atoi(word);
-	if(ppm_data.max_val != 0) {state = READ_PIXEL; continue;}
-	printf("Max value of the image is not valid.\n");
-	exit(1);
-      case READ_PIXEL:
-	if(count < ppm_data.w * ppm_data.h * 3) {
-	  ppm_data.data[count] = atoi(word);
-	  if(ppm_data.data[count] > ppm_data.max_val){
-	    printf("Pixel value overflow\n");
-	    exit(1);}
-	  count += 1;
-	  continue;}
-	break;
-      }     
-      break;
-    }while(!feof(ppm_file));
-    
-    if(count != (ppm_data.w * ppm_data.h * 3)){
-      printf("Number of pixels is not equal with the specified dimention.");
-      exit(1);
+/* Magic number, width, height and maxval; *pos is left right after maxval */
+static int read_header(const char** pos, const char* end, ppmTy* ppm, int* format){
+  const char* p = skip_space(*pos, end);
+  int v;
+
+  if(end - p < 2 || p[0] != 'P' || (p[1] != '2' && p[1] != '3' && p[1] != '5' && p[1] != '6'))
+    return PPM_ERR_HEAD;
+  *format = p[1] - '0';
+  p += 2;
+  if(p < end && !PPM_SPACE(*p) && *p != '#') return PPM_ERR_HEAD;
+
+  if((v = read_number(&p, end)) <= 0) return PPM_ERR_WIDTH;
+  ppm->w = v;
+  if((v = read_number(&p, end)) <= 0) return PPM_ERR_HEIGHT;
+  ppm->h = v;
+  /* maxval is below 2^16 (netpbm), so a pixel can be checked per digit */
+  if((v = read_number(&p, end)) <= 0 || v > 65535) return PPM_ERR_MAX_VAL;
+  ppm->max_val = v;
+  ppm->channels = *format == PPM_P2 || *format == PPM_P5 ? 1 : 3;
+  *pos = p;
+  return PPM_OK;
+}
+
+/* Sample buffer of the storage for n samples; data is used if it holds cap >= n */
+static int alloc_samples(ppmTy* ppm, size_t n, unsigned int* data, size_t cap){
+  switch(ppm->storage){
+  case PPM_U8:
+    ppm->data8 = malloc(n);
+    return ppm->data8 ? PPM_OK : PPM_ERR_MEMORY;
+  case PPM_U16:
+    ppm->data16 = malloc(sizeof(unsigned short) * n);
+    return ppm->data16 ? PPM_OK : PPM_ERR_MEMORY;
+  default:
+    ppm->data = data != NULL && cap >= n ? data : malloc(sizeof(unsigned int) * n);
+    return ppm->data ? PPM_OK : PPM_ERR_MEMORY;
+  }
+}
+
+static void store_sample(ppmTy* ppm, size_t i, unsigned int v){
+  switch(ppm->storage){
+  case PPM_U8: ppm->data8[i] = v; break;
+  case PPM_U16: ppm->data16[i] = v; break;
+  default: ppm->data[i] = v;
+  }
+}
+
+/* P2 and P3 samples */
+static int read_text_samples(const char* p, const char* end, ppmTy* ppm, size_t n){
+  size_t i;
+  for(i = 0; i < n; i++){
+    unsigned int c, pix;
+    while(p < end && PPM_SPACE(*p)) p++;
+    if(p < end && *p == '#') p = skip_space(p, end);
+    if(p == end || (c = (unsigned char) *p - '0') > 9) break;
+    pix = c;
+    for(p++; p < end && (c = (unsigned char) *p - '0') <= 9; p++){
+      pix = pix * 10 + c;
+      if(pix > ppm->max_val) return PPM_ERR_PIXEL;
+    }
+    if(pix > ppm->max_val) return PPM_ERR_PIXEL;
+    store_sample(ppm, i, pix);
+  }
+  return i == n ? PPM_OK : PPM_ERR_COUNT;
+}
+
+/* P5 and P6 samples: bytes, or big endian pairs when maxval > 255 */
+static int read_binary_samples(const unsigned char* p, ppmTy* ppm, size_t n){
+  size_t i;
+  if(ppm->max_val < 256){
+    if(ppm->storage == PPM_U8){
+      memcpy(ppm->data8, p, n);
+      for(i = 0; ppm->max_val < 255 && i < n; i++)
+        if(p[i] > ppm->max_val) return PPM_ERR_PIXEL;
+      return PPM_OK;
+    }
+    for(i = 0; i < n; i++){
+      if(p[i] > ppm->max_val) return PPM_ERR_PIXEL;
+      store_sample(ppm, i, p[i]);
     }
+    return PPM_OK;
+  }
+  for(i = 0; i < n; i++){
+    unsigned int v = p[2 * i] << 8 | p[2 * i + 1];
+    if(v > ppm->max_val) return PPM_ERR_PIXEL;
+    store_sample(ppm, i, v);
+  }
+  return PPM_OK;
+}
+
+/* 8 bit binary samples stored as PPM_U8 point into text, not copied */
+#define DECODE_ZERO_COPY 1
+/* P2 and P5 too; the callers of ppm_read expect 3 samples per pixel */
+#define DECODE_GRAY      2
+
+/* Text of a file into ppm */
+static int decode(const char* text, size_t len, ppmTy* ppm, int storage,
+                  unsigned int* data, size_t cap, int flags){
+  const char* p = text;
+  const char* end = text + len;
+  size_t n;
+  int format, err;
+
+  ppm->data = NULL;
+  ppm->data8 = NULL;
+  ppm->data16 = NULL;
+  ppm->map = NULL;
+  ppm->map_len = 0;
+  ppm->storage = storage;
+  if((err = read_header(&p, end, ppm, &format)) != PPM_OK) return err;
+  if(ppm->channels != 3 && !(flags & DECODE_GRAY)) return PPM_ERR_HEAD;
+  if(storage == PPM_U8 && ppm->max_val > 255) return PPM_ERR_DEPTH;
+  if(ppm->h > (size_t) -1 / 3 / sizeof(unsigned int) / ppm->w) return PPM_ERR_MEMORY;
+  n = (size_t) ppm->w * ppm->h * ppm->channels;
+
+  if(format == PPM_P5 || format == PPM_P6){
+    /* one whitespace byte after maxval, then the samples */
+    const unsigned char* bin = (const unsigned char*) p + 1;
+    if(p == end || (size_t) (end - (const char*) bin) < n * (ppm->max_val < 256 ? 1 : 2))
+      return PPM_ERR_COUNT;
+    if((flags & DECODE_ZERO_COPY) && storage == PPM_U8){
+      size_t i;
+      for(i = 0; ppm->max_val < 255 && i < n; i++)
+        if(bin[i] > ppm->max_val) return PPM_ERR_PIXEL;
+      ppm->data8 = (unsigned char*) bin;
+      return PPM_OK;
+    }
+    if((err = alloc_samples(ppm, n, data, cap)) != PPM_OK) return err;
+    err = read_binary_samples(bin, ppm, n);
   }
   else{
+    if((err = alloc_samples(ppm, n, data, cap)) != PPM_OK) return err;
+    err = read_text_samples(p, end, ppm, n);
+  }
+  if(err != PPM_OK){
+    /* nothing half read is handed back; the caller's data stays theirs */
+    if(ppm->data != data) free(ppm->data);
+    free(ppm->data8);
+    free(ppm->data16);
+    ppm->data = NULL;
+    ppm->data8 = NULL;
+    ppm->data16 = NULL;
+  }
+  return err;
+}
+
+int ppm_parse(const char* text, size_t len, ppmTy* ppm, unsigned int* data, size_t cap){
+  return decode(text, len, ppm, PPM_U32, data, cap, 0);
+}
+
+/* The whole file, mapped copy-on-write so that zero-copy samples can be
+   changed in place without touching the file */
+static int map_file(const char* file_name, char** text, size_t* len){
+#ifndef _WIN32
+  struct stat st;
+  void* m;
+  int fd = open(file_name, O_RDONLY);
+  if(fd < 0) return PPM_ERR_OPEN;
+  if(fstat(fd, &st) != 0){
+    close(fd);
+    return PPM_ERR_OPEN;
+  }
+  if(st.st_size == 0){
+    close(fd);
+    return PPM_ERR_HEAD;
+  }
+  m = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(m == MAP_FAILED) return PPM_ERR_OPEN;
+  madvise(m, st.st_size, MADV_SEQUENTIAL);
+  *text = m;
+  *len = st.st_size;
+#else
+  /* no mmap: the whole file in one read */
+  FILE* fp = fopen(file_name, "rb");
+  long n;
+  if(fp == NULL) return PPM_ERR_OPEN;
+  fseek(fp, 0, SEEK_END);
+  n = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  *text = malloc(n > 0 ? n : 1);
+  if(*text == NULL){
+    fclose(fp);
+    return PPM_ERR_MEMORY;
+  }
+  *len = fread(*text, 1, n, fp);
+  fclose(fp);
+#endif
+  return PPM_OK;
+}
+
+static void unmap_file(char* text, size_t len){
+#ifndef _WIN32
+  munmap(text, len);
+#else
+  (void) len;
+  free(text);
+#endif
+}
+
+int ppm_load(const char* file_name, ppmTy* ppm, unsigned int* data, size_t cap){
+  char* text;
+  size_t len;
+  int err = map_file(file_name, &text, &len);
+  if(err != PPM_OK) return err;
+  err = decode(text, len, ppm, PPM_U32, data, cap, 0);
+  unmap_file(text, len);
+  return err;
+}
+
+int ppm_load_as(const char* file_name, ppmTy* ppm, int storage){
+  char* text;
+  size_t len;
+  int err = map_file(file_name, &text, &len);
+  if(err != PPM_OK) return err;
+  err = decode(text, len, ppm, storage, NULL, 0, DECODE_ZERO_COPY | DECODE_GRAY);
+  if(err == PPM_OK && ppm->data8 >= (unsigned char*) text && ppm->data8 < (unsigned char*) text + len){
+    /* the samples are the mapping: keep it until ppm_free */
+    ppm->map = text;
+    ppm->map_len = len;
+    return PPM_OK;
+  }
+  unmap_file(text, len);
+  if(err != PPM_OK) ppm_free(ppm);
+  return err;
+}
+
+void ppm_free(ppmTy* ppm){
+  if(ppm->map != NULL) unmap_file(ppm->map, ppm->map_len);
+  else free(ppm->data8);
+  free(ppm->data16);
+  free(ppm->data);
+  ppm->data = NULL;
+  ppm->data8 = NULL;
+  ppm->data16 = NULL;
+  ppm->map = NULL;
+  ppm->map_len = 0;
+}
+
+ppmTy ppm_read(char *file_name){
+  ppmTy ppm_data;
+  int err = ppm_load(file_name, &ppm_data, NULL, 0);
+  if(err == PPM_ERR_OPEN){
     printf("cannot open the file: %s\n", file_name);
     exit(1);
   }
-  fclose(ppm_file);
+  if(err != PPM_OK){
+    printf("%s\n", ppm_error(err));
+    exit(1);
+  }
   return ppm_data;
 }
 
+/* Text output: decimal samples formatted into a large buffer that goes
+   to the file in one fwrite whenever it is nearly full. Numbers below
+   1000, which is nearly every sample, are one 4 byte copy from a table:
+   up to 3 digits and their count, which the next number overwrites. */
+#define TEXT_BUF  65536
+#define TEXT_LINE 48          /* longest line of one to three numbers */
+
+typedef struct {
+  FILE* fp;
+  char* p;
+  char small[1000][4];
+  char buf[TEXT_BUF];
+} text_out_t;
+
+static void text_init(text_out_t* o, FILE* fp){
+  int v;
+  for(v = 0; v < 1000; v++){
+    int n = v < 10 ? 1 : v < 100 ? 2 : 3, k, x = v;
+    for(k = n - 1; k >= 0; k--){
+      o->small[v][k] = '0' + x % 10;
+      x /= 10;
+    }
+    o->small[v][3] = n;
+  }
+  o->fp = fp;
+  o->p = o->buf;
+}
+
+/* Decimal of v like "%u" */
+static char* put_uint(const text_out_t* o, char* p, unsigned int v){
+  char tmp[10];
+  char* t = tmp + sizeof(tmp);
+  size_t n;
+  if(v < 1000){
+    memcpy(p, o->small[v], 4);
+    return p + o->small[v][3];
+  }
+  do{
+    *--t = '0' + v % 10;
+    v /= 10;
+  } while(v);
+  n = tmp + sizeof(tmp) - t;
+  memcpy(p, t, n);
+  return p + n;
+}
+
+/* Like "%d" */
+static char* put_int(const text_out_t* o, char* p, int v){
+  if(v < 0){
+    *p++ = '-';
+    return put_uint(o, p, 0u - (unsigned int) v);
+  }
+  return put_uint(o, p, v);
+}
+
+/* Room for the next line */
+static void text_line(text_out_t* o){
+  if(o->p > o->buf + TEXT_BUF - TEXT_LINE){
+    fwrite(o->buf, 1, o->p - o->buf, o->fp);
+    o->p = o->buf;
+  }
+}
+
+static void text_flush(text_out_t* o){
+  fwrite(o->buf, 1, o->p - o->buf, o->fp);
+  o->p = o->buf;
+}
+
+/* "%u\t%u\t%u\n" or "%u\n" */
+static void put_pixel(text_out_t* o, unsigned int channels, unsigned int r, unsigned int g, unsigned int b){
+  char* p = put_uint(o, o->p, r);
+  if(channels == 3){
+    *p++ = '\t';
+    p = put_uint(o, p, g);
+    *p++ = '\t';
+    p = put_uint(o, p, b);
+  }
+  *p++ = '\n';
+  o->p = p;
+}
+
 int ppm_write(char* file_name, ppmTy data){
   FILE *ppm_file = fopen(file_name, "w");
-  fputs("P3\n", ppm_file);
-  fprintf(ppm_file, "%d %d\n", data.w, data.h);
-  fprintf(ppm_file, "%d\n", data.max_val);
-  fputs("# R\tG\tB\n", ppm_file);
-  for(int i = 0; i < data.w * data.h * 3; i+=3){
-    fprintf(ppm_file, "%d\t%d\t%d\n", data.data[i], data.data[i+1], data.data[i+2]);
+  size_t n = (size_t) data.w * data.h * 3, i;
+  text_out_t* o;
+  if(ppm_file == NULL) return -1;
+  o = malloc(sizeof(text_out_t));
+  if(o == NULL){
+    fclose(ppm_file);
+    return -1;
   }
+  text_init(o, ppm_file);
+  /* the samples are printed as int, as they always were */
+  o->p += sprintf(o->p, "P3\n%d %d\n%d\n# R\tG\tB\n", (int) data.w, (int) data.h, (int) data.max_val);
+  for(i = 0; i < n; i += 3){
+    char* p;
+    text_line(o);
+    p = put_int(o, o->p, data.data[i]);
+    *p++ = '\t';
+    p = put_int(o, p, data.data[i + 1]);
+    *p++ = '\t';
+    p = put_int(o, p, data.data[i + 2]);
+    *p++ = '\n';
+    o->p = p;
+  }
+  text_flush(o);
+  free(o);
   fclose(ppm_file);
   return 0;
 }
+
+static unsigned int sample(const ppmTy* ppm, size_t i){
+  switch(ppm->storage){
+  case PPM_U8: return ppm->data8[i];
+  case PPM_U16: return ppm->data16[i];
+  default: return ppm->data[i];
+  }
+}
+
+size_t ppm_write_raster(FILE* fp, const ppmTy* ppm){
+  size_t n = (size_t) ppm->w * ppm->h * ppm->channels, i, k, out = 0;
+  unsigned char buf[4096];
+
+  if(ppm->max_val < 256 && ppm->storage == PPM_U8) return fwrite(ppm->data8, 1, n, fp);
+  if(ppm->max_val < 256){
+    for(i = 0; i < n; i += k){
+      for(k = 0; k < sizeof(buf) && i + k < n; k++) buf[k] = sample(ppm, i + k);
+      out += fwrite(buf, 1, k, fp);
+    }
+    return out;
+  }
+  /* big endian pairs */
+  for(i = 0; i < n; i += k){
+    for(k = 0; k < sizeof(buf) / 2 && i + k < n; k++){
+      unsigned int v = sample(ppm, i + k);
+      buf[2 * k] = v >> 8;
+      buf[2 * k + 1] = v;
+    }
+    out += fwrite(buf, 1, 2 * k, fp);
+  }
+  return out;
+}
+
+int ppm_write_as(const char* file_name, const ppmTy* ppm, int format){
+  size_t n = (size_t) ppm->w * ppm->h * ppm->channels, i;
+  FILE *ppm_file;
+
+  if(ppm->channels != (format == PPM_P2 || format == PPM_P5 ? 1u : 3u)) return -1;
+  ppm_file = fopen(file_name, format == PPM_P2 || format == PPM_P3 ? "w" : "wb");
+  if(ppm_file == NULL) return -1;
+  fprintf(ppm_file, "P%d\n%u %u\n%u\n", format, ppm->w, ppm->h, ppm->max_val);
+  if(format == PPM_P2 || format == PPM_P3){
+    text_out_t* o = malloc(sizeof(text_out_t));
+    if(o == NULL){
+      fclose(ppm_file);
+      return -1;
+    }
+    text_init(o, ppm_file);
+    /* the layout of ppm_write */
+    if(format == PPM_P3) fputs("# R\tG\tB\n", ppm_file);
+    for(i = 0; i < n; i += ppm->channels){
+      text_line(o);
+      if(ppm->channels == 1) put_pixel(o, 1, sample(ppm, i), 0, 0);
+      else put_pixel(o, 3, sample(ppm, i), sample(ppm, i + 1), sample(ppm, i + 2));
+    }
+    text_flush(o);
+    free(o);
+  }
+  else ppm_write_raster(ppm_file, ppm);
+  fclose(ppm_file);
+  return 0;
+}
+
+/* Next byte of the stream, -1 at the end */
+static int stream_byte(ppm_reader_t* r){
+  if(r->pos == r->len){
+    r->pos = 0;
+    r->len = fread(r->buf, 1, PPM_STREAM_BUF, r->fp);
+    if(r->len == 0) return -1;
+  }
+  return (unsigned char) r->buf[r->pos++];
+}
+
+/* Next P2 or P3 sample; the byte after it is left in the stream */
+static int stream_text_sample(ppm_reader_t* r, unsigned int* v){
+  unsigned int pix;
+  int c = stream_byte(r);
+  for(;;){
+    if(c == '#'){
+      while(c != '\n' && c != -1) c = stream_byte(r);
+    }
+    else if(c != -1 && PPM_SPACE(c)) c = stream_byte(r);
+    else break;
+  }
+  if(c == -1 || (unsigned) (c - '0') > 9) return PPM_ERR_COUNT;
+  pix = c - '0';
+  while((c = stream_byte(r)) != -1 && (unsigned) (c - '0') <= 9){
+    pix = pix * 10 + (c - '0');
+    if(pix > r->max_val) return PPM_ERR_PIXEL;
+  }
+  if(pix > r->max_val) return PPM_ERR_PIXEL;
+  if(c != -1) r->pos--;
+  *v = pix;
+  return PPM_OK;
+}
+
+/* n bytes of a binary stream: what is buffered, then straight from the file */
+static int stream_bytes(ppm_reader_t* r, unsigned char* dst, size_t n){
+  size_t k = r->len - r->pos < n ? r->len - r->pos : n;
+  memcpy(dst, r->buf + r->pos, k);
+  r->pos += k;
+  if(k < n && fread(dst + k, 1, n - k, r->fp) != n - k) return PPM_ERR_COUNT;
+  return PPM_OK;
+}
+
+int ppm_reader_open(ppm_reader_t* r, const char* file_name){
+  ppmTy ppm;
+  const char* p;
+  int err;
+
+  r->fp = fopen(file_name, "rb");
+  if(r->fp == NULL) return PPM_ERR_OPEN;
+  r->buf = malloc(PPM_STREAM_BUF);
+  if(r->buf == NULL){
+    fclose(r->fp);
+    return PPM_ERR_MEMORY;
+  }
+  r->pos = 0;
+  r->len = fread(r->buf, 1, PPM_STREAM_BUF, r->fp);
+  /* the header has to be in the first buffer */
+  p = r->buf;
+  err = read_header(&p, r->buf + r->len, &ppm, &r->format);
+  if(err == PPM_OK && (r->format == PPM_P5 || r->format == PPM_P6)){
+    if(p == r->buf + r->len) err = PPM_ERR_COUNT;
+    else p++;
+  }
+  if(err != PPM_OK){
+    ppm_reader_close(r);
+    return err;
+  }
+  r->pos = p - r->buf;
+  r->w = ppm.w;
+  r->h = ppm.h;
+  r->max_val = ppm.max_val;
+  r->channels = ppm.channels;
+  r->bytes = ppm.max_val < 256 ? 1 : 2;
+  r->y = 0;
+  r->err = PPM_OK;
+  return PPM_OK;
+}
+
+int ppm_reader_row(ppm_reader_t* r, void* row){
+  size_t n = (size_t) r->w * r->channels, i;
+  unsigned char* b = row;
+  unsigned short* s = row;
+
+  if(r->err != PPM_OK) return r->err;
+  if(r->y == r->h) return r->err = PPM_ERR_COUNT;
+  if(r->format == PPM_P2 || r->format == PPM_P3){
+    unsigned int v;
+    for(i = 0; i < n; i++){
+      if((r->err = stream_text_sample(r, &v)) != PPM_OK) return r->err;
+      if(r->bytes == 1) b[i] = v;
+      else s[i] = v;
+    }
+  }
+  else{
+    if((r->err = stream_bytes(r, b, n * r->bytes)) != PPM_OK) return r->err;
+    for(i = 0; i < n; i++){
+      /* in place: sample i only reads bytes 2i and 2i + 1 */
+      unsigned int v = r->bytes == 1 ? b[i] : (unsigned int) (b[2 * i] << 8 | b[2 * i + 1]);
+      if(v > r->max_val) return r->err = PPM_ERR_PIXEL;
+      if(r->bytes == 2) s[i] = v;
+    }
+  }
+  r->y++;
+  return PPM_OK;
+}
+
+int ppm_reader_band(ppm_reader_t* r, void* rows, size_t stride, int n){
+  int k;
+  for(k = 0; k < n && r->y < r->h; k++){
+    if(ppm_reader_row(r, (unsigned char*) rows + k * stride) != PPM_OK) break;
+  }
+  return k;
+}
+
+void ppm_reader_close(ppm_reader_t* r){
+  if(r->fp != NULL) fclose(r->fp);
+  free(r->buf);
+  r->fp = NULL;
+  r->buf = NULL;
+}
+
+int ppm_stream(const char* file_name, ppm_row_fn fn, void* ctx){
+  ppm_reader_t r;
+  void* row;
+  int err = ppm_reader_open(&r, file_name);
+  if(err != PPM_OK) return err;
+  row = malloc((size_t) r.w * r.channels * r.bytes);
+  if(row == NULL){
+    ppm_reader_close(&r);
+    return PPM_ERR_MEMORY;
+  }
+  while(r.y < r.h && ppm_reader_row(&r, row) == PPM_OK){
+    fn(ctx, row, r.y - 1, r.w);
+  }
+  free(row);
+  ppm_reader_close(&r);
+  return r.err;
+}
+
+int ppm_writer_open(ppm_writer_t* wr, const char* file_name, unsigned int w, unsigned int h,
+                    unsigned int max_val, int format){
+  if(format != PPM_P2 && format != PPM_P3 && format != PPM_P5 && format != PPM_P6) return PPM_ERR_HEAD;
+  if(max_val == 0 || max_val > 65535) return PPM_ERR_MAX_VAL;
+  wr->text = NULL;
+  if(format == PPM_P2 || format == PPM_P3){
+    text_out_t* o = malloc(sizeof(text_out_t));
+    if(o == NULL) return PPM_ERR_MEMORY;
+    wr->text = o;
+  }
+  wr->fp = fopen(file_name, format == PPM_P2 || format == PPM_P3 ? "w" : "wb");
+  if(wr->fp == NULL){
+    free(wr->text);
+    return PPM_ERR_OPEN;
+  }
+  if(wr->text != NULL) text_init(wr->text, wr->fp);
+  wr->w = w;
+  wr->h = h;
+  wr->max_val = max_val;
+  wr->channels = format == PPM_P2 || format == PPM_P5 ? 1 : 3;
+  wr->format = format;
+  wr->bytes = max_val < 256 ? 1 : 2;
+  wr->y = 0;
+  /* the header of ppm_write for P3, so both give the same file */
+  fprintf(wr->fp, "P%d\n%u %u\n%u\n", format, w, h, max_val);
+  if(format == PPM_P3) fputs("# R\tG\tB\n", wr->fp);
+  return PPM_OK;
+}
+
+int ppm_writer_row(ppm_writer_t* wr, const void* row){
+  size_t n = (size_t) wr->w * wr->channels, i, k;
+  const unsigned char* b = row;
+  const unsigned short* s = row;
+  unsigned char buf[4096];
+
+  if(wr->y == wr->h) return PPM_ERR_COUNT;
+  if(wr->format == PPM_P2 || wr->format == PPM_P3){
+    text_out_t* o = wr->text;
+    for(i = 0; i < n; i += wr->channels){
+      text_line(o);
+      if(wr->channels == 1)
+        put_pixel(o, 1, wr->bytes == 1 ? b[i] : s[i], 0, 0);
+      else if(wr->bytes == 1)
+        put_pixel(o, 3, b[i], b[i + 1], b[i + 2]);
+      else
+        put_pixel(o, 3, s[i], s[i + 1], s[i + 2]);
+    }
+  }
+  else if(wr->bytes == 1){
+    fwrite(b, 1, n, wr->fp);
+  }
+  else{
+    for(i = 0; i < n; i += k){
+      for(k = 0; k < sizeof(buf) / 2 && i + k < n; k++){
+        buf[2 * k] = s[i + k] >> 8;
+        buf[2 * k + 1] = s[i + k];
+      }
+      fwrite(buf, 1, 2 * k, wr->fp);
+    }
+  }
+  wr->y++;
+  return ferror(wr->fp) ? PPM_ERR_OPEN : PPM_OK;
+}
+
+int ppm_writer_close(ppm_writer_t* wr){
+  int err = wr->y == wr->h ? PPM_OK : PPM_ERR_COUNT;
+  if(wr->text != NULL){
+    text_flush(wr->text);
+    free(wr->text);
+    wr->text = NULL;
+  }
+  if(fclose(wr->fp) != 0 && err == PPM_OK) err = PPM_ERR_OPEN;
+  wr->fp = NULL;
+  return err;
+}
@@ -9,14 +9,108 @@
 #include <stdbool.h>
 #include <string.h>
 
+/* File formats, the digit of the magic number */
+enum { PPM_P2 = 2, PPM_P3 = 3, PPM_P5 = 5, PPM_P6 = 6 };
+
+/* Storage of the samples: data, data8 or data16 */
+enum { PPM_U32 = 0, PPM_U8, PPM_U16 };
+
 typedef struct {
   unsigned int w;
   unsigned int h;
   unsigned int max_val;
   unsigned int *data;
+  unsigned int channels;     /* 3 (P3, P6) or 1 (P2, P5) */
+  int storage;
+  unsigned char *data8;
+  unsigned short *data16;
+  void *map;                 /* file mapping data8 points into, or NULL */
+  size_t map_len;
 } ppmTy;
 
+/* Results of ppm_parse and ppm_load */
+enum {
+  PPM_OK = 0,
+  PPM_ERR_OPEN,
+  PPM_ERR_HEAD,
+  PPM_ERR_WIDTH,
+  PPM_ERR_HEIGHT,
+  PPM_ERR_MAX_VAL,
+  PPM_ERR_PIXEL,
+  PPM_ERR_COUNT,
+  PPM_ERR_MEMORY,
+  PPM_ERR_DEPTH
+};
+
+/* Reads a P3 or P6 file; prints the error and exits if it is not valid */
 ppmTy ppm_read(char *file_name);
 int ppm_write(char* file_name, ppmTy data);
 
+/* P3 or P6 text of len bytes (no terminating 0 needed) into ppm. The
+   samples go to data if it holds cap values or more, else to a new
+   buffer. Gray files are PPM_ERR_HEAD here, read them with ppm_load_as. */
+int ppm_parse(const char* text, size_t len, ppmTy* ppm, unsigned int* data, size_t cap);
+/* ppm_parse of a file, memory-mapped; nothing is allocated when data is big enough */
+int ppm_load(const char* file_name, ppmTy* ppm, unsigned int* data, size_t cap);
+/* Any of P2, P3, P5 and P6 in the given storage. 8 bit binary samples in
+   PPM_U8 are not copied: data8 points into the (private, writable)
+   mapping of the file. Release with ppm_free. */
+int ppm_load_as(const char* file_name, ppmTy* ppm, int storage);
+void ppm_free(ppmTy* ppm);
+/* ppm in the given format, which must match its channels */
+int ppm_write_as(const char* file_name, const ppmTy* ppm, int format);
+/* Samples of ppm as in a P5 or P6 file, returns the bytes written */
+size_t ppm_write_raster(FILE* fp, const ppmTy* ppm);
+const char* ppm_error(int err);
+
+/*
+ * Row by row access, for images that do not fit in memory or to start
+ * processing before the whole file is read. A row is w * channels
+ * samples, unsigned char when max_val < 256 and unsigned short (host
+ * order) otherwise; bytes is the size of one sample.
+ */
+#ifndef PPM_STREAM_BUF
+#define PPM_STREAM_BUF 65536
+#endif
+
+typedef struct {
+  FILE* fp;
+  unsigned int w, h, max_val, channels;
+  int format;
+  unsigned int bytes;
+  unsigned int y;     /* rows read */
+  int err;            /* first error, then every call returns it */
+  char* buf;
+  size_t pos, len;
+} ppm_reader_t;
+
+typedef struct {
+  FILE* fp;
+  unsigned int w, h, max_val, channels;
+  int format;
+  unsigned int bytes;
+  unsigned int y;     /* rows written */
+  void* text;         /* output buffer of P2 and P3 */
+} ppm_writer_t;
+
+/* Row y of a w pixel wide image; row is only valid during the call */
+typedef void (*ppm_row_fn)(void* ctx, const void* row, int y, int w);
+
+/* Reads the header; the header has to fit in PPM_STREAM_BUF bytes */
+int ppm_reader_open(ppm_reader_t* r, const char* file_name);
+/* Next row, PPM_OK or the error */
+int ppm_reader_row(ppm_reader_t* r, void* row);
+/* Up to n rows, stride bytes apart; returns how many were read */
+int ppm_reader_band(ppm_reader_t* r, void* rows, size_t stride, int n);
+void ppm_reader_close(ppm_reader_t* r);
+/* fn on every row of the file, in order, with one row of memory */
+int ppm_stream(const char* file_name, ppm_row_fn fn, void* ctx);
+
+/* Writes the header; channels follow from the format */
+int ppm_writer_open(ppm_writer_t* wr, const char* file_name, unsigned int w, unsigned int h,
+                    unsigned int max_val, int format);
+int ppm_writer_row(ppm_writer_t* wr, const void* row);
+/* PPM_ERR_COUNT if fewer than h rows were written */
+int ppm_writer_close(ppm_writer_t* wr);
+
 #endif
@@ -0,0 +1,131 @@
+#include "ppm_seq.h"
+
+#include <dirent.h>
+
+/*
+ * Packs PPM and PGM files into a sequence file (ppm_seq.h), lists one or
+ * takes a frame back out of one:
+ *
+ *   ppm_pack OUT PATH...         files, or the *.ppm and *.pgm files of a
+ *                                directory in name order, like ppm2h
+ *   ppm_pack -l SEQ              frames of SEQ
+ *   ppm_pack -x SEQ N OUT        frame N (from 0) as a P5 or P6 file
+ */
+
+static int by_name(const void* a, const void* b){
+  return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+static int is_image(const char* name){
+  size_t n = strlen(name);
+  return n > 4 && (strcmp(name + n - 4, ".ppm") == 0 || strcmp(name + n - 4, ".pgm") == 0);
+}
+
+static int add_file(ppm_seq_writer_t* wr, const char* file_name){
+  ppmTy ppm;
+  int err = ppm_load_as(file_name, &ppm, PPM_U8);
+  if(err == PPM_ERR_DEPTH) err = ppm_load_as(file_name, &ppm, PPM_U16);
+  if(err == PPM_OK){
+    err = ppm_seq_add(wr, &ppm);
+    ppm_free(&ppm);
+  }
+  if(err != PPM_OK) printf("%s: %s\n", file_name, ppm_error(err));
+  return err;
+}
+
+/* The images of a directory, or path itself if it is not one */
+static int add_path(ppm_seq_writer_t* wr, const char* path){
+  DIR* dir = opendir(path);
+  struct dirent* d;
+  char** names = NULL;
+  size_t n = 0, cap = 0, i;
+  int err = PPM_OK;
+
+  if(dir == NULL) return add_file(wr, path);
+  while((d = readdir(dir)) != NULL){
+    if(!is_image(d->d_name)) continue;
+    if(n == cap){
+      cap = cap ? 2 * cap : 16;
+      names = realloc(names, cap * sizeof(char*));
+    }
+    names[n] = malloc(strlen(path) + strlen(d->d_name) + 2);
+    sprintf(names[n++], "%s/%s", path, d->d_name);
+  }
+  closedir(dir);
+  qsort(names, n, sizeof(char*), by_name);
+  for(i = 0; i < n; i++){
+    if(err == PPM_OK) err = add_file(wr, names[i]);
+    free(names[i]);
+  }
+  free(names);
+  return err;
+}
+
+static int list(const char* file_name){
+  ppm_seq_t s;
+  ppm_frame_t f;
+  unsigned int i;
+  int err = ppm_seq_open(&s, file_name);
+  if(err != PPM_OK){
+    printf("%s: %s\n", file_name, ppm_error(err));
+    return 1;
+  }
+  printf("%u frames\n", s.frames);
+  for(i = 0; i < s.frames; i++){
+    if((err = ppm_seq_frame(&s, i, &f)) != PPM_OK){
+      printf("%u: %s\n", i, ppm_error(err));
+      break;
+    }
+    printf("%u: P%d %u x %u, max %u, %lu bytes at %lu\n", i, f.format, f.w, f.h, f.max_val,
+           (unsigned long) f.size, (unsigned long) (f.data - (const unsigned char*) s.map));
+  }
+  ppm_seq_close(&s);
+  return err != PPM_OK;
+}
+
+static int extract(const char* file_name, unsigned int i, const char* out){
+  ppm_seq_t s;
+  ppm_frame_t f;
+  FILE* fp;
+  int err = ppm_seq_open(&s, file_name);
+  if(err == PPM_OK) err = ppm_seq_frame(&s, i, &f);
+  if(err != PPM_OK){
+    printf("%s: %s\n", file_name, ppm_error(err));
+    ppm_seq_close(&s);
+    return 1;
+  }
+  fp = fopen(out, "wb");
+  if(fp == NULL){
+    printf("cannot open the file: %s\n", out);
+    ppm_seq_close(&s);
+    return 1;
+  }
+  /* the payload is the raster of the file */
+  fprintf(fp, "P%d\n%u %u\n%u\n", f.format, f.w, f.h, f.max_val);
+  fwrite(f.data, 1, f.size, fp);
+  fclose(fp);
+  ppm_seq_close(&s);
+  return 0;
+}
+
+int main(int argc, char** argv){
+  ppm_seq_writer_t wr;
+  int i, err;
+
+  if(argc == 3 && strcmp(argv[1], "-l") == 0) return list(argv[2]);
+  if(argc == 5 && strcmp(argv[1], "-x") == 0) return extract(argv[2], atoi(argv[3]), argv[4]);
+  if(argc < 3 || argv[1][0] == '-'){
+    printf("usage: ppm_pack OUT PATH...\n"
+           "       ppm_pack -l SEQ\n"
+           "       ppm_pack -x SEQ N OUT\n");
+    return 1;
+  }
+  if((err = ppm_seq_create(&wr, argv[1])) != PPM_OK){
+    printf("cannot open the file: %s\n", argv[1]);
+    return 1;
+  }
+  for(i = 2; i < argc && err == PPM_OK; i++) err = add_path(&wr, argv[i]);
+  printf("%u frames\n", wr.frames);
+  if(ppm_seq_finish(&wr) != PPM_OK && err == PPM_OK) err = PPM_ERR_OPEN;
+  return err != PPM_OK;
+}
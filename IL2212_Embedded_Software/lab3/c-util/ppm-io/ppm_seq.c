@@ -0,0 +1,201 @@
+#include "ppm_seq.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static unsigned long long get_le(const unsigned char* p, int n){
+  unsigned long long v = 0;
+  while(n--) v = v << 8 | p[n];
+  return v;
+}
+
+static void put_le(unsigned char* p, unsigned long long v, int n){
+  int i;
+  for(i = 0; i < n; i++){
+    p[i] = v;
+    v >>= 8;
+  }
+}
+
+int ppm_seq_open(ppm_seq_t* s, const char* file_name){
+  const unsigned char* m;
+  unsigned long long index;
+#ifndef _WIN32
+  struct stat st;
+  void* map;
+  int fd = open(file_name, O_RDONLY);
+  if(fd < 0) return PPM_ERR_OPEN;
+  if(fstat(fd, &st) != 0){
+    close(fd);
+    return PPM_ERR_OPEN;
+  }
+  if(st.st_size < PPM_SEQ_HEADER){
+    close(fd);
+    return PPM_ERR_HEAD;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED) return PPM_ERR_OPEN;
+  s->map = map;
+  s->len = st.st_size;
+#else
+  /* no mmap: the whole file in one read */
+  FILE* fp = fopen(file_name, "rb");
+  long n;
+  if(fp == NULL) return PPM_ERR_OPEN;
+  fseek(fp, 0, SEEK_END);
+  n = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  s->map = malloc(n > 0 ? n : 1);
+  if(s->map == NULL){
+    fclose(fp);
+    return PPM_ERR_MEMORY;
+  }
+  s->len = fread(s->map, 1, n, fp);
+  fclose(fp);
+#endif
+  m = s->map;
+  s->frames = 0;
+  s->index = NULL;
+  if(s->len < PPM_SEQ_HEADER || memcmp(m, PPM_SEQ_MAGIC, 8) != 0 || get_le(m + 8, 4) != PPM_SEQ_VERSION){
+    ppm_seq_close(s);
+    return PPM_ERR_HEAD;
+  }
+  s->frames = get_le(m + 12, 4);
+  index = get_le(m + 16, 8);
+  if(index > s->len || (s->len - index) / PPM_SEQ_ENTRY < s->frames){
+    ppm_seq_close(s);
+    return PPM_ERR_COUNT;
+  }
+  s->index = m + index;
+  return PPM_OK;
+}
+
+int ppm_seq_frame(const ppm_seq_t* s, unsigned int i, ppm_frame_t* f){
+  const unsigned char* e;
+  unsigned long long offset, size;
+
+  if(i >= s->frames) return PPM_ERR_COUNT;
+  e = s->index + (size_t) i * PPM_SEQ_ENTRY;
+  offset = get_le(e, 8);
+  size = get_le(e + 8, 8);
+  f->w = get_le(e + 16, 4);
+  f->h = get_le(e + 20, 4);
+  f->max_val = get_le(e + 24, 4);
+  f->format = get_le(e + 28, 4);
+  if(f->format != PPM_P5 && f->format != PPM_P6) return PPM_ERR_HEAD;
+  if(f->max_val == 0 || f->max_val > 65535) return PPM_ERR_MAX_VAL;
+  f->channels = f->format == PPM_P5 ? 1 : 3;
+  f->bytes = f->max_val < 256 ? 1 : 2;
+  /* the size has to be the raster, all of it in the file */
+  if(offset > s->len || size > s->len - offset || f->h == 0 ||
+     size / f->h / f->channels / f->bytes != f->w || size % ((size_t) f->h * f->channels * f->bytes) != 0)
+    return PPM_ERR_COUNT;
+  f->data = (const unsigned char*) s->map + offset;
+  f->size = size;
+  return PPM_OK;
+}
+
+int ppm_seq_ppm(const ppm_seq_t* s, unsigned int i, ppmTy* ppm){
+  ppm_frame_t f;
+  int err = ppm_seq_frame(s, i, &f);
+  if(err != PPM_OK) return err;
+  if(f.bytes != 1) return PPM_ERR_DEPTH;
+  ppm->w = f.w;
+  ppm->h = f.h;
+  ppm->max_val = f.max_val;
+  ppm->channels = f.channels;
+  ppm->storage = PPM_U8;
+  ppm->data = NULL;
+  ppm->data8 = (unsigned char*) f.data;
+  ppm->data16 = NULL;
+  /* owned by the sequence */
+  ppm->map = NULL;
+  ppm->map_len = 0;
+  return PPM_OK;
+}
+
+void ppm_seq_close(ppm_seq_t* s){
+#ifndef _WIN32
+  if(s->map != NULL) munmap(s->map, s->len);
+#else
+  free(s->map);
+#endif
+  s->map = NULL;
+  s->len = 0;
+  s->frames = 0;
+  s->index = NULL;
+}
+
+/* Header with the count and the place of the index */
+static void seq_header(unsigned char* h, unsigned int frames, unsigned long long index){
+  memset(h, 0, PPM_SEQ_HEADER);
+  memcpy(h, PPM_SEQ_MAGIC, 8);
+  put_le(h + 8, PPM_SEQ_VERSION, 4);
+  put_le(h + 12, frames, 4);
+  put_le(h + 16, index, 8);
+}
+
+int ppm_seq_create(ppm_seq_writer_t* wr, const char* file_name){
+  unsigned char h[PPM_SEQ_HEADER];
+  wr->fp = fopen(file_name, "wb");
+  if(wr->fp == NULL) return PPM_ERR_OPEN;
+  wr->frames = 0;
+  wr->cap = 0;
+  wr->index = NULL;
+  /* no index yet: an unfinished file has no frames */
+  seq_header(h, 0, PPM_SEQ_HEADER);
+  fwrite(h, 1, PPM_SEQ_HEADER, wr->fp);
+  wr->pos = PPM_SEQ_HEADER;
+  return PPM_OK;
+}
+
+int ppm_seq_add(ppm_seq_writer_t* wr, const ppmTy* ppm){
+  static const unsigned char zeros[PPM_SEQ_ALIGN];
+  size_t pad = (PPM_SEQ_ALIGN - wr->pos % PPM_SEQ_ALIGN) % PPM_SEQ_ALIGN;
+  size_t size = (size_t) ppm->w * ppm->h * ppm->channels * (ppm->max_val < 256 ? 1 : 2);
+  unsigned char* e;
+
+  if(ppm->channels != 1 && ppm->channels != 3) return PPM_ERR_HEAD;
+  if(ppm->max_val == 0 || ppm->max_val > 65535) return PPM_ERR_MAX_VAL;
+  if(wr->frames == wr->cap){
+    unsigned int cap = wr->cap ? 2 * wr->cap : 64;
+    unsigned char* index = realloc(wr->index, (size_t) cap * PPM_SEQ_ENTRY);
+    if(index == NULL) return PPM_ERR_MEMORY;
+    wr->index = index;
+    wr->cap = cap;
+  }
+  fwrite(zeros, 1, pad, wr->fp);
+  wr->pos += pad;
+  if(ppm_write_raster(wr->fp, ppm) != size) return PPM_ERR_OPEN;
+
+  e = wr->index + (size_t) wr->frames * PPM_SEQ_ENTRY;
+  put_le(e, wr->pos, 8);
+  put_le(e + 8, size, 8);
+  put_le(e + 16, ppm->w, 4);
+  put_le(e + 20, ppm->h, 4);
+  put_le(e + 24, ppm->max_val, 4);
+  put_le(e + 28, ppm->channels == 1 ? PPM_P5 : PPM_P6, 4);
+  wr->pos += size;
+  wr->frames++;
+  return PPM_OK;
+}
+
+int ppm_seq_finish(ppm_seq_writer_t* wr){
+  unsigned char h[PPM_SEQ_HEADER];
+  int err = PPM_OK;
+
+  if(wr->frames > 0) fwrite(wr->index, PPM_SEQ_ENTRY, wr->frames, wr->fp);
+  seq_header(h, wr->frames, wr->pos);
+  if(fseek(wr->fp, 0, SEEK_SET) != 0 || fwrite(h, 1, PPM_SEQ_HEADER, wr->fp) != PPM_SEQ_HEADER)
+    err = PPM_ERR_OPEN;
+  if(fclose(wr->fp) != 0) err = PPM_ERR_OPEN;
+  free(wr->index);
+  wr->fp = NULL;
+  wr->index = NULL;
+  return err;
+}
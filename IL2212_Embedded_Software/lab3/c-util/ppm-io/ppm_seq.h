@@ -0,0 +1,66 @@
+#ifndef PPM_SEQ_H
+#define PPM_SEQ_H
+
+/*
+ * A sequence of frames in one file, for test sequences and recordings
+ * that are read many times: the pixels are stored raw, so reading a frame
+ * is a pointer into the mapped file and nothing is parsed.
+ *
+ * Layout, all fields little endian:
+ *
+ *   header   "PPMSEQ1\0", u32 version (1), u32 frames,
+ *            u64 offset of the index, u64 0                 32 bytes
+ *   payloads the samples of each frame, on 64 byte boundaries
+ *   index    per frame: u64 offset, u64 size, u32 w, u32 h,
+ *            u32 max_val, u32 format (PPM_P5 or PPM_P6)     32 bytes
+ *
+ * A payload is the raster of a P5 or P6 file: 1 byte per sample, or 2
+ * bytes big endian when max_val > 255. The index is written last, so
+ * frames are added one at a time without knowing how many there are.
+ */
+
+#include "ppm_io.h"
+
+#define PPM_SEQ_MAGIC   "PPMSEQ1"
+#define PPM_SEQ_VERSION 1
+#define PPM_SEQ_HEADER  32
+#define PPM_SEQ_ENTRY   32
+#define PPM_SEQ_ALIGN   64
+
+typedef struct {
+  void* map;
+  size_t len;
+  unsigned int frames;
+  const unsigned char* index;
+} ppm_seq_t;
+
+typedef struct {
+  unsigned int w, h, max_val, channels;
+  unsigned int bytes;              /* per sample */
+  int format;
+  const unsigned char* data;       /* in the mapping, valid until ppm_seq_close */
+  size_t size;
+} ppm_frame_t;
+
+typedef struct {
+  FILE* fp;
+  unsigned int frames, cap;
+  unsigned char* index;
+  unsigned long long pos;          /* end of the file so far */
+} ppm_seq_writer_t;
+
+/* Maps the file and checks the header and the place of the index */
+int ppm_seq_open(ppm_seq_t* s, const char* file_name);
+/* Frame i, PPM_ERR_COUNT if there is no such frame in the file */
+int ppm_seq_frame(const ppm_seq_t* s, unsigned int i, ppm_frame_t* f);
+/* Frame i as 8 bit samples in the mapping (no copy); not for ppm_free */
+int ppm_seq_ppm(const ppm_seq_t* s, unsigned int i, ppmTy* ppm);
+void ppm_seq_close(ppm_seq_t* s);
+
+int ppm_seq_create(ppm_seq_writer_t* wr, const char* file_name);
+/* Appends a frame of any storage; 1 channel frames become P5, 3 P6 */
+int ppm_seq_add(ppm_seq_writer_t* wr, const ppmTy* ppm);
+/* Writes the index and the header */
+int ppm_seq_finish(ppm_seq_writer_t* wr);
+
+#endif
@@ -1,11 +1,37 @@
 #include "ppm_io.h"
 
+/* Copies the file row by row into the format given as P2, P3, P5 or P6 */
+static int convert(char* in, char* out, char* format){
+  ppm_reader_t r;
+  ppm_writer_t w;
+  void* row;
+  int err = ppm_reader_open(&r, in);
+  if(err != PPM_OK){
+    printf("%s\n", ppm_error(err));
+    return 1;
+  }
+  w.fp = NULL;
+  err = ppm_writer_open(&w, out, r.w, r.h, r.max_val, format[1] - '0');
+  if(err == PPM_OK && w.channels != r.channels) err = PPM_ERR_HEAD;
+  row = malloc((size_t) r.w * r.channels * r.bytes);
+  while(err == PPM_OK && r.y < r.h){
+    if((err = ppm_reader_row(&r, row)) == PPM_OK) err = ppm_writer_row(&w, row);
+  }
+  if(w.fp != NULL && ppm_writer_close(&w) != PPM_OK && err == PPM_OK) err = PPM_ERR_COUNT;
+  ppm_reader_close(&r);
+  free(row);
+  if(err != PPM_OK) printf("%s\n", ppm_error(err));
+  return err != PPM_OK;
+}
+
 int main(int argc, char** argv){
   if(argc < 3){
     printf("Please provide the input/output file name\n");
     return 1;
   }
+  if(argc > 3) return convert(argv[1], argv[2], argv[3]);
   ppmTy ppm = ppm_read(argv[1]);
   ppm_write(argv[2], ppm);
+  free(ppm.data);
   return 0;
 }